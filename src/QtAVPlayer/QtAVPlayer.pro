@@ -34,6 +34,9 @@ PRIVATE_HEADERS += \
     qavvideooutputfilter_p.h \
     qavaudiooutputfilter_p.h \
     qaviodevice_p.h \
+    qavframepool_p.h \
+    qavringbuffer_p.h \
+    qavtrace_p.h \
     qavfilters_p.h
 
 PUBLIC_HEADERS += \
@@ -45,10 +48,14 @@ PUBLIC_HEADERS += \
     qavsubtitleframe.h \
     qtavplayerglobal.h \
     qavstream.h \
-    qavplayer.h
+    qavplayer.h \
+    qavthumbnailer.h \
+    qavframereader.h
 
 SOURCES += \
     qavplayer.cpp \
+    qavthumbnailer.cpp \
+    qavframereader.cpp \
     qavcodec.cpp \
     qavframecodec.cpp \
     qavaudiocodec.cpp \
@@ -73,6 +80,8 @@ SOURCES += \
     qavvideooutputfilter.cpp \
     qavaudiooutputfilter.cpp \
     qaviodevice.cpp \
+    qavframepool.cpp \
+    qavtrace.cpp \
     qavstream.cpp \
     qavfilters.cpp
 
@@ -7,19 +7,114 @@
 
 #include "qavaudiocodec_p.h"
 #include "qavcodec_p_p.h"
+#include <QMutex>
 #include <QDebug>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
 }
 
 QT_BEGIN_NAMESPACE
 
+// Keeps the samples between frames, until the input format changes
+struct QAVResampler
+{
+    SwrContext *swr_ctx = nullptr;
+    int64_t inChannelLayout = 0;
+    int inFormat = AV_SAMPLE_FMT_NONE;
+    int inSampleRate = 0;
+    QAVAudioFormat outAudioFormat;
+};
+
+class QAVAudioCodecPrivate : public QAVCodecPrivate
+{
+public:
+    QByteArray &buffer(int size);
+    QAVResampler &resampler(const QAVAudioFormat &fmt);
+    void clearResamplers();
+
+    QMutex mutex;
+    // One per output format, so consumers of different formats do not reset each other
+    QList<QAVResampler> resamplers;
+    // Converted samples, reused when frames do not reference them
+    QList<QByteArray> buffers;
+    QByteArray extraBuffer;
+};
+
+QByteArray &QAVAudioCodecPrivate::buffer(int size)
+{
+    const int maxBuffers = 16;
+    QByteArray *buf = nullptr;
+    for (auto &b : buffers) {
+        if (b.isDetached()) {
+            buf = &b;
+            break;
+        }
+    }
+
+    if (!buf) {
+        // All buffers are still used, the extra one is not kept
+        if (buffers.size() >= maxBuffers) {
+            extraBuffer = QByteArray();
+            buf = &extraBuffer;
+        } else {
+            buffers.append(QByteArray());
+            buf = &buffers.last();
+        }
+    }
+
+    // Reserved capacity keeps the data while resizing
+    if (buf->capacity() < size)
+        buf->reserve(size);
+    buf->resize(size);
+    return *buf;
+}
+
+QAVResampler &QAVAudioCodecPrivate::resampler(const QAVAudioFormat &fmt)
+{
+    const int maxResamplers = 4;
+    for (auto &r : resamplers) {
+        if (r.outAudioFormat == fmt)
+            return r;
+    }
+
+    if (resamplers.size() >= maxResamplers) {
+        swr_free(&resamplers.first().swr_ctx);
+        resamplers.removeFirst();
+    }
+    resamplers.append(QAVResampler());
+    resamplers.last().outAudioFormat = fmt;
+    return resamplers.last();
+}
+
+void QAVAudioCodecPrivate::clearResamplers()
+{
+    for (auto &r : resamplers)
+        swr_free(&r.swr_ctx);
+    resamplers.clear();
+}
+
 QAVAudioCodec::QAVAudioCodec(QObject *parent)
-    : QAVFrameCodec(parent)
+    : QAVFrameCodec(*new QAVAudioCodecPrivate, parent)
 {
 }
 
+QAVAudioCodec::~QAVAudioCodec()
+{
+    Q_D(QAVAudioCodec);
+    d->clearResamplers();
+}
+
+void QAVAudioCodec::flushBuffers()
+{
+    Q_D(QAVAudioCodec);
+    QAVCodec::flushBuffers();
+    QMutexLocker locker(&d->mutex);
+    d->clearResamplers();
+}
+
 QAVAudioFormat QAVAudioCodec::audioFormat() const
 {
     Q_D(const QAVCodec);
@@ -27,14 +122,15 @@ QAVAudioFormat QAVAudioCodec::audioFormat() const
     if (!d->avctx)
         return format;
 
-    auto fmt = AVSampleFormat(d->avctx->sample_fmt);
+    // Planar samples are interleaved without changing the sample format
+    auto fmt = av_get_packed_sample_fmt(AVSampleFormat(d->avctx->sample_fmt));
     if (fmt == AV_SAMPLE_FMT_U8)
         format.setSampleFormat(QAVAudioFormat::UInt8);
     else if (fmt == AV_SAMPLE_FMT_S16)
         format.setSampleFormat(QAVAudioFormat::Int16);
     else if (fmt == AV_SAMPLE_FMT_S32)
         format.setSampleFormat(QAVAudioFormat::Int32);
-    else if (fmt == AV_SAMPLE_FMT_FLT)
+    else if (fmt == AV_SAMPLE_FMT_FLT || fmt == AV_SAMPLE_FMT_DBL || fmt == AV_SAMPLE_FMT_S64)
         format.setSampleFormat(QAVAudioFormat::Float);
 
     format.setSampleRate(d->avctx->sample_rate);
@@ -43,4 +139,87 @@ QAVAudioFormat QAVAudioCodec::audioFormat() const
     return format;
 }
 
+QByteArray QAVAudioCodec::convert(const AVFrame *frame, const QAVAudioFormat &fmt, bool rawData)
+{
+    Q_D(QAVAudioCodec);
+    AVSampleFormat outFormat = AV_SAMPLE_FMT_NONE;
+    int64_t outChannelLayout = av_get_default_channel_layout(fmt.channelCount());
+    int outSampleRate = fmt.sampleRate();
+
+    switch (fmt.sampleFormat()) {
+    case QAVAudioFormat::UInt8:
+        outFormat = AV_SAMPLE_FMT_U8;
+        break;
+    case QAVAudioFormat::Int16:
+        outFormat = AV_SAMPLE_FMT_S16;
+        break;
+    case QAVAudioFormat::Int32:
+        outFormat = AV_SAMPLE_FMT_S32;
+        break;
+    case QAVAudioFormat::Float:
+        outFormat = AV_SAMPLE_FMT_FLT;
+        break;
+    default:
+        qWarning() << "Could not negotiate output format";
+        return {};
+    }
+
+    int64_t channelLayout = (frame->channel_layout && frame->channels == av_get_channel_layout_nb_channels(frame->channel_layout))
+        ? frame->channel_layout
+        : av_get_default_channel_layout(frame->channels);
+
+    bool needsConvert = frame->format != outFormat || channelLayout != outChannelLayout || frame->sample_rate != outSampleRate;
+    if (!needsConvert) {
+        int size = av_samples_get_buffer_size(NULL,
+                                              frame->channels,
+                                              frame->nb_samples,
+                                              AVSampleFormat(frame->format), 1);
+        return rawData
+            ? QByteArray::fromRawData((const char *)frame->data[0], size)
+            : QByteArray((const char *)frame->data[0], size);
+    }
+
+    QMutexLocker locker(&d->mutex);
+    auto &r = d->resampler(fmt);
+    if (!r.swr_ctx
+        || channelLayout != r.inChannelLayout
+        || frame->format != r.inFormat
+        || frame->sample_rate != r.inSampleRate)
+    {
+        swr_free(&r.swr_ctx);
+        r.swr_ctx = swr_alloc_set_opts(nullptr,
+                                       outChannelLayout, outFormat, outSampleRate,
+                                       channelLayout, AVSampleFormat(frame->format), frame->sample_rate,
+                                       0, nullptr);
+        int ret = swr_init(r.swr_ctx);
+        if (!r.swr_ctx || ret < 0) {
+            qWarning() << "Could not init SwrContext" << ret;
+            swr_free(&r.swr_ctx);
+            return {};
+        }
+        r.inChannelLayout = channelLayout;
+        r.inFormat = frame->format;
+        r.inSampleRate = frame->sample_rate;
+    }
+
+    const uint8_t **in = (const uint8_t **)frame->extended_data;
+    int outCount = swr_get_out_samples(r.swr_ctx, frame->nb_samples);
+    int outSize = av_samples_get_buffer_size(nullptr, fmt.channelCount(), outCount, outFormat, 1);
+    if (outCount < 0 || outSize < 0) {
+        qWarning() << "Could not get output size";
+        return {};
+    }
+
+    QByteArray &buf = d->buffer(outSize);
+    uint8_t *out = reinterpret_cast<uint8_t *>(buf.data());
+    int samples = swr_convert(r.swr_ctx, &out, outCount, in, frame->nb_samples);
+    if (samples < 0) {
+        qWarning() << "Could not convert audio samples";
+        return {};
+    }
+
+    buf.resize(samples * fmt.channelCount() * av_get_bytes_per_sample(outFormat));
+    return buf;
+}
+
 QT_END_NAMESPACE
@@ -24,14 +24,26 @@
 
 QT_BEGIN_NAMESPACE
 
+struct AVFrame;
+class QAVAudioCodecPrivate;
 class Q_AVPLAYER_EXPORT QAVAudioCodec : public QAVFrameCodec
 {
 public:
     QAVAudioCodec(QObject *parent = nullptr);
+    ~QAVAudioCodec();
     QAVAudioFormat audioFormat() const;
 
+    // Converts the samples of the frame by the resampler kept for the output format,
+    // output buffers are reused when they are not referenced anymore.
+    // Samples in the requested format are copied, or point to the frame if rawData
+    // is set: then they are valid only while the frame is alive
+    QByteArray convert(const AVFrame *frame, const QAVAudioFormat &format, bool rawData = false);
+    // Also drops the samples buffered by the resamplers
+    void flushBuffers() override;
+
 private:
     Q_DISABLE_COPY(QAVAudioCodec)
+    Q_DECLARE_PRIVATE(QAVAudioCodec)
 };
 
 QT_END_NAMESPACE
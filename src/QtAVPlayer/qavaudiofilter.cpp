@@ -8,6 +8,7 @@
 #include "qavaudiofilter_p.h"
 #include "qavfilter_p_p.h"
 #include "qavcodec_p.h"
+#include "qavframe_p.h"
 #include "qavstream.h"
 #include <QDebug>
 
@@ -48,6 +49,11 @@ QAVAudioFilter::QAVAudioFilter(
 }
 
 int QAVAudioFilter::write(const QAVFrame &frame)
+{
+    return write(QAVFrame(frame));
+}
+
+int QAVAudioFilter::write(QAVFrame &&frame)
 {
     Q_D(QAVAudioFilter);
     if (!frame || frame.stream().stream()->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
@@ -57,12 +63,16 @@ int QAVAudioFilter::write(const QAVFrame &frame)
     if (!d->isEmpty)
         return AVERROR(EAGAIN);
 
-    d->sourceFrame = frame;
+    d->sourceFrame = std::move(frame);
+    // Other copies of the frame are not detached, the filter only reads it
+    const AVFrame *src = std::as_const(d->sourceFrame).frame();
     for (auto &filter : d->inputs) {
-        QAVFrame ref = frame;
-        int ret = av_buffersrc_add_frame_flags(filter.ctx(), ref.frame(), 0);
+        // The filter references the buffers by itself
+        int ret = av_buffersrc_add_frame_flags(filter.ctx(), const_cast<AVFrame *>(src), AV_BUFFERSRC_FLAG_KEEP_REF);
         if (ret < 0)
             return ret;
+        if (src->buf[0])
+            QAVFrameCounters::m_filterRefs.fetch_add(1, std::memory_order_relaxed);
     }
     d->isEmpty = false;
     return 0;
@@ -72,7 +82,7 @@ void QAVAudioFilter::read(QAVFrame &frame)
 {
     Q_D(QAVAudioFilter);
     if (d->outputs.isEmpty() || d->isEmpty) {
-        frame = d->sourceFrame;
+        frame = std::move(d->sourceFrame);
         d->sourceFrame = {};
         d->isEmpty = true;
         return;
@@ -83,23 +93,20 @@ void QAVAudioFilter::read(QAVFrame &frame)
         for (int i = 0; i < d->outputs.size(); ++i) {
             const auto &filter = d->outputs[i];
             while (true) {
-                QAVFrame out = d->sourceFrame;
-                // av_buffersink_get_frame_flags allocates frame's data
-                av_frame_unref(out.frame());
+                QAVFrame out;
                 ret = av_buffersink_get_frame_flags(filter.ctx(), out.frame(), 0);
                 if (ret < 0)
                     break;
 
                 if (!out.frame()->pkt_duration)
-                    out.frame()->pkt_duration = d->sourceFrame.frame()->pkt_duration;
+                    out.frame()->pkt_duration = std::as_const(d->sourceFrame).frame()->pkt_duration;
                 frame.setTimeBase(av_buffersink_get_time_base(filter.ctx()));
                 out.setFilterName(
                     !filter.name().isEmpty()
                     ? filter.name()
                     : QString(QLatin1String("%1:%2")).arg(d->name).arg(QString::number(i)));
-                if (!out.stream())
-                    out.setStream(d->stream);
-                d->outputFrames.push_back(out);
+                out.setStream(d->sourceFrame.stream() ? d->sourceFrame.stream() : d->stream);
+                d->outputFrames.push_back(std::move(out));
             }
         }
     }
@@ -14,7 +14,6 @@
 QT_BEGIN_NAMESPACE
 
 class QAVAudioCodec;
-class QAVAudioFramePrivate;
 class Q_AVPLAYER_EXPORT QAVAudioFrame : public QAVFrame
 {
 public:
@@ -22,16 +21,20 @@ public:
     ~QAVAudioFrame();
     QAVAudioFrame(const QAVFrame &other, QObject *parent = nullptr);
     QAVAudioFrame(const QAVAudioFrame &other, QObject *parent = nullptr);
+    QAVAudioFrame(QAVAudioFrame &&other) noexcept;
     QAVAudioFrame &operator=(const QAVFrame &other);
     QAVAudioFrame &operator=(const QAVAudioFrame &other);
+    QAVAudioFrame &operator=(QAVAudioFrame &&other) noexcept;
 
+    // Native format of the samples, always interleaved
     QAVAudioFormat format() const;
     QByteArray data() const;
-
-private:
-    Q_DECLARE_PRIVATE(QAVAudioFrame)
+    // Converts the samples only if the format differs
+    QByteArray data(const QAVAudioFormat &format) const;
 };
 
+Q_DECLARE_TYPEINFO(QAVAudioFrame, Q_MOVABLE_TYPE);
+
 Q_DECLARE_METATYPE(QAVAudioFrame)
 
 QT_END_NAMESPACE
@@ -13,10 +13,17 @@
 #include <QWaitCondition>
 #include <QCoreApplication>
 #include <QThreadPool>
+#include <QElapsedTimer>
+#include "qavringbuffer_p.h"
+#include "qavaudiocodec_p.h"
+#include <atomic>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #include <QAudioOutput>
+#include <QAudioDeviceInfo>
 #else
 #include <QAudioSink>
+#include <QAudioDevice>
+#include <QMediaDevices>
 #endif
 
 extern "C" {
@@ -76,6 +83,58 @@ static QAudioFormat format(const QAVAudioFormat &from)
     return out;
 }
 
+// Prefers the native sample format of the frames if the device supports it
+static QAVAudioFormat negotiate(const QAVAudioFormat &from)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    const auto device = QAudioDeviceInfo::defaultOutputDevice();
+#else
+    const auto device = QMediaDevices::defaultAudioOutput();
+#endif
+    const QAVAudioFormat::SampleFormat sampleFormats[] = {
+        from.sampleFormat(),
+        QAVAudioFormat::Float,
+        QAVAudioFormat::Int32,
+        QAVAudioFormat::Int16
+    };
+
+    for (auto sampleFormat : sampleFormats) {
+        QAVAudioFormat out = from;
+        out.setSampleFormat(sampleFormat);
+        auto fmt = format(out);
+        if (fmt.isValid() && device.isFormatSupported(fmt))
+            return out;
+    }
+
+    return from;
+}
+
+// Bytes of one sample of all channels
+static int bytesPerFrame(const QAVAudioFormat &fmt)
+{
+    int bytes = 0;
+    switch (fmt.sampleFormat()) {
+    case QAVAudioFormat::UInt8:
+        bytes = 1;
+        break;
+    case QAVAudioFormat::Int16:
+        bytes = 2;
+        break;
+    case QAVAudioFormat::Int32:
+    case QAVAudioFormat::Float:
+        bytes = 4;
+        break;
+    default:
+        break;
+    }
+    return bytes * fmt.channelCount();
+}
+
+static int bytesPerSecond(const QAVAudioFormat &fmt)
+{
+    return bytesPerFrame(fmt) * fmt.sampleRate();
+}
+
 class QAVAudioOutputPrivate : public QIODevice
 {
 public:
@@ -95,45 +154,36 @@ public:
     AudioOutput *audioOutput = nullptr;
     qreal volume = 1.0;
     int bufferSize = 0;
-    QList<QAVAudioFrame> frames;
-    qint64 offset = 0;
-    bool quit = 0;
+    std::atomic<int> latency { 250 };
+    // Converted samples, written by play() and read by the device
+    QAVRingBuffer ring;
+    // Signalled by the device when it reads the samples
+    QMutex spaceMutex;
+    QWaitCondition spaceCond;
+    // Used only by play()
+    QAVAudioFormat inFormat;
+    int ringLatency = 0;
+    bool stalled = false;
+    size_t stalledPos = 0;
+    // Negotiated with the device, the ring is resized by the audio thread
+    QAVAudioFormat outFormat;
+    bool resetting = false;
+    std::atomic<bool> quit { false };
     mutable QMutex mutex;
     QWaitCondition cond;
+    QWaitCondition resetCond;
     QThreadPool threadPool;
 
+    // Called by the device, only copies the samples
     qint64 readData(char *data, qint64 len) override
     {
         if (!len)
             return 0;
 
-        QMutexLocker locker(&mutex);
-        qint64 bytesWritten = 0;
-        while (len && !quit) {
-            if (frames.isEmpty()) {
-                // Wait for more frames
-                if (bytesWritten == 0)
-                    cond.wait(&mutex);
-                if (frames.isEmpty())
-                    break;
-            }
-
-            auto frame = frames.front();
-            auto sampleData = frame.data();
-            const int toWrite = qMin(sampleData.size() - offset, len);
-            memcpy(data, sampleData.constData() + offset, toWrite);
-            bytesWritten += toWrite;
-            data += toWrite;
-            len -= toWrite;
-            offset += toWrite;
-
-            if (offset >= sampleData.size()) {
-                offset = 0;
-                frames.removeFirst();
-            }
-        }
-
-        return bytesWritten;
+        const qint64 bytesRead = qint64(ring.read(data, size_t(len)));
+        if (bytesRead > 0)
+            wakeWriter();
+        return bytesRead;
     }
 
     qint64 writeData(const char *, qint64) override { return 0; }
@@ -142,6 +192,75 @@ public:
     bool isSequential() const override { return true; }
     bool atEnd() const override { return false; }
 
+    // Waits until the device plays the samples of the previous format,
+    // and lets the audio thread resize the ring for the new one
+    bool reset(const QAVAudioFormat &in)
+    {
+        const int ms = latency;
+        waitForSpace(ring.capacity(), ms);
+        auto out = negotiate(in);
+
+        QMutexLocker locker(&mutex);
+        inFormat = in;
+        ringLatency = ms;
+        outFormat = out;
+        resetting = true;
+        cond.wakeAll();
+        while (resetting && !quit)
+            resetCond.wait(&mutex, 10);
+        return !resetting;
+    }
+
+    void wakeWriter()
+    {
+        {
+            QMutexLocker locker(&spaceMutex);
+        }
+        spaceCond.wakeAll();
+    }
+
+    // Waits while the device reads the samples, gives up if it does not make progress
+    bool waitForSpace(size_t bytes, int ms)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        size_t pos = ring.readPosition();
+        // The device has read something since it stalled
+        if (stalled && pos != stalledPos)
+            stalled = false;
+        QMutexLocker locker(&spaceMutex);
+        while (!quit && ring.capacity() - ring.size() < bytes) {
+            if (ring.readPosition() != pos) {
+                pos = ring.readPosition();
+                timer.restart();
+                stalled = false;
+            } else if (stalled || timer.elapsed() > ms) {
+                stalled = true;
+                stalledPos = pos;
+                return false;
+            }
+            spaceCond.wait(&spaceMutex, qMax<qint64>(1, ms - timer.elapsed()));
+        }
+        return !quit;
+    }
+
+    // Writes only whole frames, the rest of the data is dropped if the device stalls
+    bool write(const QByteArray &data)
+    {
+        const size_t frame = size_t(qMax(1, bytesPerFrame(outFormat)));
+        const char *ptr = data.constData();
+        size_t len = size_t(data.size()) / frame * frame;
+        while (len > 0) {
+            const size_t space = ring.capacity() - ring.size();
+            const size_t written = ring.write(ptr, qMin(len, space) / frame * frame);
+            ptr += written;
+            len -= written;
+            if (len > 0 && !waitForSpace(qMin(len, qMax(frame, ring.capacity() / frame * frame)), ringLatency))
+                return false;
+        }
+        return true;
+    }
+
     void init(const QAudioFormat &fmt)
     {
         if (!audioOutput || (fmt.isValid() && audioOutput->format() != fmt) || audioOutput->state() == QAudio::StoppedState) {
@@ -173,8 +292,18 @@ public:
         while (!quit) {
             QMutexLocker locker(&mutex);
             cond.wait(&mutex, 10);
-            auto fmt =  !frames.isEmpty() ? format(frames.first().format()) : QAudioFormat();
+            auto out = outFormat;
+            if (resetting) {
+                // The device is stopped before the ring is resized
+                if (audioOutput)
+                    audioOutput->stop();
+                ring.resize(size_t(qint64(bytesPerSecond(out)) * ringLatency / 1000));
+                resetting = false;
+                resetCond.wakeAll();
+            }
             locker.unlock();
+
+            auto fmt = out.sampleRate() > 0 ? format(out) : QAudioFormat();
             if (fmt.isValid())
                 init(fmt);
             QCoreApplication::processEvents();
@@ -203,6 +332,7 @@ QAVAudioOutput::~QAVAudioOutput()
     Q_D(QAVAudioOutput);
     d->quit = true;
     d->cond.wakeAll();
+    d->wakeWriter();
     d->audioPlayFuture.waitForFinished();
 }
 
@@ -227,17 +357,49 @@ int QAVAudioOutput::bufferSize() const
     return d->bufferSize;
 }
 
+void QAVAudioOutput::setLatency(int ms)
+{
+    Q_D(QAVAudioOutput);
+    d->latency = qMax(10, ms);
+}
+
+int QAVAudioOutput::latency() const
+{
+    Q_D(const QAVAudioOutput);
+    return d->latency;
+}
+
+int QAVAudioOutput::bufferedDuration() const
+{
+    Q_D(const QAVAudioOutput);
+    QMutexLocker locker(&d->mutex);
+    const int bytes = bytesPerSecond(d->outFormat);
+    return bytes > 0 ? int(qint64(d->ring.size()) * 1000 / bytes) : 0;
+}
+
+qint64 QAVAudioOutput::underruns() const
+{
+    Q_D(const QAVAudioOutput);
+    return d->ring.underruns();
+}
+
 bool QAVAudioOutput::play(const QAVAudioFrame &frame)
 {
     Q_D(QAVAudioOutput);
     if (d->quit || !frame)
         return false;
 
-    QMutexLocker locker(&d->mutex);
-    d->frames.push_back(frame);
-    d->cond.wakeAll();
+    auto in = frame.format();
+    if ((in != d->inFormat || d->latency != d->ringLatency) && !d->reset(in))
+        return false;
+
+    auto c = static_cast<QAVAudioCodec *>(frame.stream().codec().data());
+    if (!c)
+        return false;
 
-    return true;
+    // Converted on the caller thread, the device only copies the samples.
+    // Samples already in the output format are written from the frame, it outlives the write
+    return d->write(c->convert(frame.frame(), d->outFormat, true));
 }
 
 QT_END_NAMESPACE
@@ -25,6 +25,17 @@ public:
     void setBufferSize(int bytes);
     int bufferSize() const;
 
+    // Target duration of the converted samples waiting for the device, in ms
+    void setLatency(int ms);
+    int latency() const;
+    // Duration of the samples waiting for the device, in ms
+    int bufferedDuration() const;
+    // How many times the device ran out of samples
+    qint64 underruns() const;
+
+    // Converts the frame and blocks until the device reads enough samples if the buffer is full,
+    // but not longer than the latency if the device does not read.
+    // Returns false if the frame could not be buffered
     bool play(const QAVAudioFrame &frame);
 
 protected:
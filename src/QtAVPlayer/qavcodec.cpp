@@ -67,7 +67,19 @@ bool QAVCodec::open(AVStream *stream)
     d->avctx->codec_id = d->codec->id;
 
     av_opt_set_int(d->avctx, "refcounted_frames", true, 0);
-    av_opt_set_int(d->avctx, "threads", 1, 0);
+    av_opt_set_int(d->avctx, "threads", d->threads, 0);
+    if (d->threadType)
+        d->avctx->thread_type = d->threadType;
+    if (d->lowresSize.isValid()) {
+        int lowres = 0;
+        while (lowres < d->codec->max_lowres
+               && (d->avctx->width >> (lowres + 1)) >= d->lowresSize.width()
+               && (d->avctx->height >> (lowres + 1)) >= d->lowresSize.height())
+        {
+            ++lowres;
+        }
+        d->avctx->lowres = lowres;
+    }
     ret = avcodec_open2(d->avctx, d->codec, nullptr);
     if (ret < 0) {
         qWarning() << "Could not open the codec:" << d->codec->name << ret;
@@ -90,6 +102,36 @@ const AVCodec *QAVCodec::codec() const
     return d_func()->codec;
 }
 
+void QAVCodec::setThreads(int threads)
+{
+    d_func()->threads = qMax(threads, 0);
+}
+
+int QAVCodec::threads() const
+{
+    return d_func()->threads;
+}
+
+void QAVCodec::setThreadType(int type)
+{
+    d_func()->threadType = type;
+}
+
+int QAVCodec::threadType() const
+{
+    return d_func()->threadType;
+}
+
+void QAVCodec::setLowresSize(const QSize &size)
+{
+    d_func()->lowresSize = size;
+}
+
+QSize QAVCodec::lowresSize() const
+{
+    return d_func()->lowresSize;
+}
+
 void QAVCodec::flushBuffers()
 {
      Q_D(QAVCodec);
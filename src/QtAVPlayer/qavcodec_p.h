@@ -23,6 +23,7 @@
 #include "qavframe.h"
 #include <QtAVPlayer/qtavplayerglobal.h>
 #include <QObject>
+#include <QSize>
 #include <memory>
 
 QT_BEGIN_NAMESPACE
@@ -41,7 +42,17 @@ public:
     void setCodec(const AVCodec *c);
     const AVCodec *codec() const;
 
-    void flushBuffers();
+    // 0 means auto detect
+    void setThreads(int threads);
+    int threads() const;
+    // FF_THREAD_FRAME and/or FF_THREAD_SLICE
+    void setThreadType(int type);
+    int threadType() const;
+    // Decodes at reduced resolution if supported, but not less than the size
+    void setLowresSize(const QSize &size);
+    QSize lowresSize() const;
+
+    virtual void flushBuffers();
 
     // Sends a packet
     virtual int write(const QAVPacket &pkt) = 0;
@@ -34,6 +34,9 @@ public:
     AVCodecContext *avctx = nullptr;
     const AVCodec *codec = nullptr;
     AVStream *stream = nullptr;
+    int threads = 1;
+    int threadType = 0;
+    QSize lowresSize;
 };
 
 QT_END_NAMESPACE
@@ -11,6 +11,7 @@
 #include "qavsubtitlecodec_p.h"
 #include "qavhwdevice_p.h"
 #include "qaviodevice_p.h"
+#include "qavtrace_p.h"
 #include "qtQtAVPlayer-config_p.h"
 #include <QtAVPlayer/qtavplayerglobal.h>
 
@@ -83,12 +84,58 @@ public:
     QString inputFormat;
     QString inputVideoCodec;
     QMap<QString, QString> inputOptions;
+    int decodingThreads = 1;
+    int decodingThreadType = 0;
+    QSize videoLowresSize;
+    qint64 framePoolSize = 0;
 
     bool eof = false;
     QList<QAVPacket> packets;
     QString bsfs;
+
+    // Keyframe timestamps to byte positions per video stream,
+    // the timestamps are dts as in the index entries
+    QMap<int, QMap<qint64, qint64>> keyframes;
+    // Max pts - dts per video stream, the frames are shown after this delay
+    QMap<int, qint64> reorderDelays;
 };
 
+static void loadIndexEntries(AVStream *stream, QMap<qint64, qint64> &index)
+{
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    const int count = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < count; ++i) {
+        const AVIndexEntry *entry = avformat_index_get_entry(stream, i);
+        if (entry && (entry->flags & AVINDEX_KEYFRAME))
+            index[entry->timestamp] = entry->pos;
+    }
+#else
+    for (int i = 0; i < stream->nb_index_entries; ++i) {
+        const AVIndexEntry &entry = stream->index_entries[i];
+        if (entry.flags & AVINDEX_KEYFRAME)
+            index[entry.timestamp] = entry.pos;
+    }
+#endif
+}
+
+// Guessed from the number of reordered frames until the packets are read
+static qint64 reorderDelay(AVStream *stream)
+{
+    const AVRational rate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+    if (stream->codecpar->video_delay <= 0 || rate.num <= 0 || rate.den <= 0)
+        return 0;
+    return av_rescale_q(stream->codecpar->video_delay, av_inv_q(rate), stream->time_base);
+}
+
+static int indexEntriesCount(AVStream *stream)
+{
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    return avformat_index_get_entries_count(stream);
+#else
+    return stream->nb_index_entries;
+#endif
+}
+
 static int decode_interrupt_cb(void *ctx)
 {
     auto d = reinterpret_cast<QAVDemuxerPrivate *>(ctx);
@@ -360,6 +407,9 @@ int QAVDemuxer::load(const QString &url, QAVIODevice *dev)
     if (ret < 0)
         return ret;
 
+    if (dev)
+        dev->setBitRate(d->ctx->bit_rate);
+
     locker.relock();
     av_log_set_callback(log_callback);
 
@@ -371,6 +421,13 @@ int QAVDemuxer::load(const QString &url, QAVIODevice *dev)
     if (ret < 0)
         return ret;
 
+    for (std::size_t i = 0; i < d->ctx->nb_streams; ++i) {
+        if (d->ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            loadIndexEntries(d->ctx->streams[i], d->keyframes[int(i)]);
+            d->reorderDelays[int(i)] = reorderDelay(d->ctx->streams[i]);
+        }
+    }
+
     const int videoStreamIndex = av_find_best_stream(
         d->ctx,
         AVMEDIA_TYPE_VIDEO,
@@ -423,6 +480,11 @@ int QAVDemuxer::resetCodecs()
             return AVERROR(EINVAL);
         }
     }
+    auto newCodec = [d](QAVCodec *codec) {
+        codec->setThreads(d->decodingThreads);
+        codec->setThreadType(d->decodingThreadType);
+        return QSharedPointer<QAVCodec>(codec);
+    };
     int ret = 0;
     for (std::size_t i = 0; i < d->ctx->nb_streams && ret >= 0; ++i) {
         if (!d->ctx->streams[i]->codecpar) {
@@ -433,19 +495,21 @@ int QAVDemuxer::resetCodecs()
         switch (type) {
             case AVMEDIA_TYPE_VIDEO:
             {
-                QSharedPointer<QAVCodec> codec(new QAVVideoCodec);
+                auto codec = newCodec(new QAVVideoCodec);
+                codec->setLowresSize(d->videoLowresSize);
+                static_cast<QAVVideoCodec *>(codec.data())->setFramePoolSize(d->framePoolSize);
                 if (videoCodec)
                     codec->setCodec(videoCodec);
                 d->availableStreams.push_back({ int(i), d->ctx->streams[i], codec });
                 ret = setup_video_codec(d->ctx->streams[i], *static_cast<QAVVideoCodec *>(codec.data()));
             } break;
             case AVMEDIA_TYPE_AUDIO:
-                d->availableStreams.push_back({ int(i), d->ctx->streams[i], QSharedPointer<QAVCodec>(new QAVAudioCodec) });
+                d->availableStreams.push_back({ int(i), d->ctx->streams[i], newCodec(new QAVAudioCodec) });
                 if (!d->availableStreams.last().codec()->open(d->ctx->streams[i]))
                     qWarning() << "Could not open audio codec for stream:" << i;
                 break;
             case AVMEDIA_TYPE_SUBTITLE:
-                d->availableStreams.push_back({ int(i), d->ctx->streams[i], QSharedPointer<QAVCodec>(new QAVSubtitleCodec) });
+                d->availableStreams.push_back({ int(i), d->ctx->streams[i], newCodec(new QAVSubtitleCodec) });
                 if (!d->availableStreams.last().codec()->open(d->ctx->streams[i]))
                     qWarning() << "Could not open subtitle codec for stream:" << i;
                 break;
@@ -623,6 +687,8 @@ void QAVDemuxer::unload()
     d->currentAudioStreams.clear();
     d->currentSubtitleStreams.clear();
     d->availableStreams.clear();
+    d->keyframes.clear();
+    d->reorderDelays.clear();
     av_bsf_free(&d->bsf_ctx);
     d->bsf_ctx = nullptr;
 }
@@ -636,6 +702,7 @@ bool QAVDemuxer::eof() const
 
 QAVPacket QAVDemuxer::read()
 {
+    QAV_TRACE("QAVDemuxer::read");
     Q_D(QAVDemuxer);
     QMutexLocker locker(&d->mutex);
     if (!d->packets.isEmpty())
@@ -656,6 +723,20 @@ QAVPacket QAVDemuxer::read()
     }
     locker.relock();
 
+    // Remembers keyframes seen during playback
+    auto keyframes = d->keyframes.find(pkt.packet()->stream_index);
+    if (ret >= 0 && keyframes != d->keyframes.end()) {
+        const int64_t pts = pkt.packet()->pts;
+        const int64_t dts = pkt.packet()->dts;
+        if (pts != AV_NOPTS_VALUE && dts != AV_NOPTS_VALUE) {
+            auto &delay = d->reorderDelays[pkt.packet()->stream_index];
+            delay = qMax(delay, qint64(pts - dts));
+        }
+        const int64_t ts = dts != AV_NOPTS_VALUE ? dts : pts;
+        if ((pkt.packet()->flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE)
+            keyframes->insert(ts, pkt.packet()->pos);
+    }
+
     QAVStream stream = pkt.packet()->stream_index < d->availableStreams.size()
                        ? d->availableStreams[pkt.packet()->stream_index]
                        : QAVStream();
@@ -665,8 +746,12 @@ QAVPacket QAVDemuxer::read()
     if (d->bsf_ctx) {
         ret = av_bsf_send_packet(d->bsf_ctx, d->eof ? NULL : pkt.packet());
         if (ret >= 0) {
-            while ((ret = av_bsf_receive_packet(d->bsf_ctx, pkt.packet())) >= 0)
+            while ((ret = av_bsf_receive_packet(d->bsf_ctx, pkt.packet())) >= 0) {
                 d->packets.append(pkt);
+                // Next packet is received to own data
+                pkt = QAVPacket();
+                pkt.setStream(stream);
+            }
         }
         if (ret < 0 && ret != AVERROR_EOF && ret != AVERROR(EAGAIN)) {
             qWarning() << "Error applying bitstream filters to an output:" << ret;
@@ -683,6 +768,7 @@ void QAVDemuxer::decode(const QAVPacket &pkt, QList<QAVFrame> &frames) const
 {
     if (!pkt.stream())
         return;
+    QAV_TRACE("QAVDemuxer::decode");
     int sent = 0;
     do {
         sent = pkt.send();
@@ -698,7 +784,7 @@ void QAVDemuxer::decode(const QAVPacket &pkt, QList<QAVFrame> &frames) const
             int received = frame.receive();
             if (received < 0)
                 break;
-            frames.push_back(frame);
+            frames.push_back(std::move(frame));
         }
     } while (sent == AVERROR(EAGAIN));
 }
@@ -707,6 +793,7 @@ void QAVDemuxer::decode(const QAVPacket &pkt, QList<QAVSubtitleFrame> &frames) c
 {
     if (!pkt.stream())
         return;
+    QAV_TRACE("QAVDemuxer::decode");
     int sent = pkt.send();
     if (sent < 0 && sent != AVERROR(EAGAIN))
         return;
@@ -714,7 +801,7 @@ void QAVDemuxer::decode(const QAVPacket &pkt, QList<QAVSubtitleFrame> &frames) c
     QAVSubtitleFrame frame;
     frame.setStream(pkt.stream());
     if (frame.receive() >= 0)
-        frames.push_back(frame);
+        frames.push_back(std::move(frame));
 }
 
 void QAVDemuxer::flushCodecBuffers()
@@ -741,8 +828,38 @@ int QAVDemuxer::seek(double sec)
         return AVERROR(EINVAL);
 
     d->eof = false;
+
+    // Jumps directly to the nearest known keyframe of the video stream
+    int index = -1;
+    int64_t keyframe = AV_NOPTS_VALUE;
+    int64_t pos = -1;
+    if (!d->currentVideoStreams.isEmpty()) {
+        index = d->currentVideoStreams.first().index();
+        const auto &keyframes = d->keyframes[index];
+        // Keyframes are stored by dts, their pts is later by the reorder delay
+        const int64_t ts = sec / av_q2d(d->ctx->streams[index]->time_base) - d->reorderDelays.value(index);
+        auto it = keyframes.upperBound(ts);
+        if (it != keyframes.begin()) {
+            --it;
+            keyframe = it.key();
+            pos = it.value();
+        }
+    }
+    const bool byteSeek = pos >= 0
+        && keyframe != AV_NOPTS_VALUE
+        && !indexEntriesCount(d->ctx->streams[index])
+        && !(d->ctx->iformat->flags & AVFMT_NO_BYTE_SEEK);
     locker.unlock();
 
+    if (keyframe != AV_NOPTS_VALUE) {
+        // No index in the format, but the position of the keyframe is known
+        int ret = byteSeek
+            ? avformat_seek_file(d->ctx, -1, pos, pos, pos, AVSEEK_FLAG_BYTE)
+            : avformat_seek_file(d->ctx, index, INT64_MIN, keyframe, keyframe, 0);
+        if (ret >= 0)
+            return ret;
+    }
+
     int flags = AVSEEK_FLAG_BACKWARD;
     int64_t target = sec * AV_TIME_BASE;
     int64_t min = INT_MIN;
@@ -750,6 +867,21 @@ int QAVDemuxer::seek(double sec)
     return avformat_seek_file(d->ctx, -1, min, target, max, flags);
 }
 
+QList<double> QAVDemuxer::keyframes(int index) const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    QList<double> result;
+    auto it = d->keyframes.find(index);
+    if (!d->ctx || it == d->keyframes.end())
+        return result;
+
+    const double tb = av_q2d(d->ctx->streams[index]->time_base);
+    for (auto ts : it->keys())
+        result.append(ts * tb);
+    return result;
+}
+
 double QAVDemuxer::duration() const
 {
     Q_D(const QAVDemuxer);
@@ -854,6 +986,62 @@ void QAVDemuxer::setInputOptions(const QMap<QString, QString> &opts)
     d->inputOptions = opts;
 }
 
+int QAVDemuxer::decodingThreads() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->decodingThreads;
+}
+
+void QAVDemuxer::setDecodingThreads(int threads)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    d->decodingThreads = threads;
+}
+
+int QAVDemuxer::decodingThreadType() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->decodingThreadType;
+}
+
+void QAVDemuxer::setDecodingThreadType(int type)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    d->decodingThreadType = type;
+}
+
+QSize QAVDemuxer::videoLowresSize() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->videoLowresSize;
+}
+
+void QAVDemuxer::setVideoLowresSize(const QSize &size)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    d->videoLowresSize = size;
+}
+
+qint64 QAVDemuxer::framePoolSize() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->framePoolSize;
+}
+
+void QAVDemuxer::setFramePoolSize(qint64 bytes)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    d->framePoolSize = qMax<qint64>(bytes, 0);
+}
+
 QStringList QAVDemuxer::supportedBitstreamFilters()
 {
     QStringList result;
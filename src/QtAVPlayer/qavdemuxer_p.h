@@ -25,6 +25,7 @@
 #include "qavsubtitleframe.h"
 #include <QObject>
 #include <QMap>
+#include <QSize>
 #include <memory>
 
 QT_BEGIN_NAMESPACE
@@ -73,7 +74,10 @@ public:
 
     double duration() const;
     bool seekable() const;
+    // Seeks to the nearest known keyframe before sec
     int seek(double sec);
+    // Decoding timestamps of known keyframes of the video stream in seconds, the list grows during reading
+    QList<double> keyframes(int index) const;
     bool eof() const;
     double videoFrameRate() const;
 
@@ -91,6 +95,19 @@ public:
     QMap<QString, QString> inputOptions() const;
     void setInputOptions(const QMap<QString, QString> &opts);
 
+    int decodingThreads() const;
+    void setDecodingThreads(int threads);
+
+    int decodingThreadType() const;
+    void setDecodingThreadType(int type);
+
+    QSize videoLowresSize() const;
+    void setVideoLowresSize(const QSize &size);
+
+    // Limits memory of decoded video frames, applied on next load
+    qint64 framePoolSize() const;
+    void setFramePoolSize(qint64 bytes);
+
     static QStringList supportedFormats();
     static QStringList supportedVideoCodecs();
     static QStringList supportedProtocols();
@@ -34,6 +34,8 @@ public:
     ~QAVFilter();
 
     virtual int write(const QAVFrame &frame) = 0;
+    // Takes the frame only if it is accepted
+    virtual int write(QAVFrame &&frame) = 0;
     virtual void read(QAVFrame &frame) = 0;
     // Checks if all frames have been read
     bool isEmpty() const;
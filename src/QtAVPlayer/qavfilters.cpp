@@ -8,6 +8,7 @@
 #include "qavfilters_p.h"
 #include "qavvideofilter_p.h"
 #include "qavaudiofilter_p.h"
+#include "qavtrace_p.h"
 #include <QDebug>
 
 extern "C" {
@@ -111,12 +112,13 @@ int QAVFilters::createFilters(
 }
 
 static int writeFrame(
-    const QAVFrame &decodedFrame,
+    QAVFrame &&decodedFrame,
     const std::vector<std::unique_ptr<QAVFilter>> &filters)
 {
     int ret = 0;
+    // Only the last filter takes the frame
     for (size_t i = 0; i < filters.size() && ret >= 0; ++i)
-        ret = filters[i]->write(decodedFrame);
+        ret = i + 1 < filters.size() ? filters[i]->write(decodedFrame) : filters[i]->write(std::move(decodedFrame));
     return ret;
 }
 
@@ -124,12 +126,20 @@ int QAVFilters::write(
     AVMediaType mediaType,
     const QAVFrame &decodedFrame)
 {
+    return write(mediaType, QAVFrame(decodedFrame));
+}
+
+int QAVFilters::write(
+    AVMediaType mediaType,
+    QAVFrame &&decodedFrame)
+{
+    QAV_TRACE("QAVFilters::write");
     QMutexLocker locker(&m_mutex);
     switch (mediaType) {
     case AVMEDIA_TYPE_VIDEO:
-        return writeFrame(decodedFrame, m_videoFilters);
+        return writeFrame(std::move(decodedFrame), m_videoFilters);
     case AVMEDIA_TYPE_AUDIO:
-        return writeFrame(decodedFrame, m_audioFilters);
+        return writeFrame(std::move(decodedFrame), m_audioFilters);
     default:
         qWarning() << "Unsupported codec type:" << mediaType;
         break;
@@ -138,23 +148,29 @@ int QAVFilters::write(
 }
 
 static int readFrames(
-    const QAVFrame &decodedFrame,
+    QAVFrame &&decodedFrame,
     const std::vector<std::unique_ptr<QAVFilter>> &filters,
     QList<QAVFrame> &filteredFrames)
 {
-    QAVFrame frame;
     if (filters.empty()) {
         if (decodedFrame)
-            filteredFrames.append(decodedFrame);
+            filteredFrames.append(std::move(decodedFrame));
         return 0;
     }
 
-    // Read all frames from all filters at once
+    // Read all frames from all filters at once,
+    // frames without pts take the pts of the previous frame
+    int64_t pts = AV_NOPTS_VALUE;
     for (size_t i = 0; i < filters.size(); ++i) {
         do {
+            QAVFrame frame;
             filters[i]->read(frame);
-            if (frame)
-                filteredFrames.append(frame);
+            if (!frame)
+                continue;
+            if (std::as_const(frame).frame()->pts < 0 && pts >= 0)
+                frame.frame()->pts = pts;
+            pts = std::as_const(frame).frame()->pts;
+            filteredFrames.append(std::move(frame));
         } while (!filters[i]->isEmpty());
     }
     return 0;
@@ -165,12 +181,21 @@ int QAVFilters::read(
     const QAVFrame &decodedFrame,
     QList<QAVFrame> &filteredFrames)
 {
+    return read(mediaType, QAVFrame(decodedFrame), filteredFrames);
+}
+
+int QAVFilters::read(
+    AVMediaType mediaType,
+    QAVFrame &&decodedFrame,
+    QList<QAVFrame> &filteredFrames)
+{
+    QAV_TRACE("QAVFilters::read");
     QMutexLocker locker(&m_mutex);
     switch (mediaType) {
     case AVMEDIA_TYPE_VIDEO:
-        return readFrames(decodedFrame, m_videoFilters, filteredFrames);
+        return readFrames(std::move(decodedFrame), m_videoFilters, filteredFrames);
     case AVMEDIA_TYPE_AUDIO:
-        return readFrames(decodedFrame, m_audioFilters, filteredFrames);
+        return readFrames(std::move(decodedFrame), m_audioFilters, filteredFrames);
     default:
         qWarning() << "Unsupported codec type:" << mediaType;
         break;
@@ -211,6 +236,23 @@ void QAVFilters::flush()
     flushFilters(m_audioFilters);
 }
 
+static void discardFrames(const std::vector<std::unique_ptr<QAVFilter>> &filters)
+{
+    for (const auto &filter : filters) {
+        while (!filter->isEmpty()) {
+            QAVFrame frame;
+            filter->read(frame);
+        }
+    }
+}
+
+void QAVFilters::discard()
+{
+    QMutexLocker locker(&m_mutex);
+    discardFrames(m_videoFilters);
+    discardFrames(m_audioFilters);
+}
+
 void QAVFilters::clear()
 {
     QMutexLocker locker(&m_mutex);
@@ -41,13 +41,24 @@ public:
     int write(
         AVMediaType mediaType,
         const QAVFrame &decodedFrame);
+    // Takes the frame only if a filter accepts it
+    int write(
+        AVMediaType mediaType,
+        QAVFrame &&decodedFrame);
     int read(
         AVMediaType mediaType,
         const QAVFrame &decodedFrame,
         QList<QAVFrame> &filteredFrames);
+    // Takes the frame only if there are no filters
+    int read(
+        AVMediaType mediaType,
+        QAVFrame &&decodedFrame,
+        QList<QAVFrame> &filteredFrames);
     QList<QString> filterDescs() const;
     bool isEmpty() const;
     void flush();
+    // Drops filtered frames which have not been read yet, keeps the graphs
+    void discard();
     void clear();
 
 private:
@@ -8,6 +8,7 @@
 #include "qavframe.h"
 #include "qavstream.h"
 #include "qavframe_p.h"
+#include "qavframepool_p.h"
 #include <QDebug>
 
 extern "C" {
@@ -16,39 +17,85 @@ extern "C" {
 
 QT_BEGIN_NAMESPACE
 
+std::atomic<qint64> QAVFrameCounters::m_refs { 0 };
+std::atomic<qint64> QAVFrameCounters::m_unrefs { 0 };
+std::atomic<qint64> QAVFrameCounters::m_filterRefs { 0 };
+
+qint64 QAVFrameCounters::refs()
+{
+    return m_refs.load(std::memory_order_relaxed);
+}
+
+qint64 QAVFrameCounters::unrefs()
+{
+    return m_unrefs.load(std::memory_order_relaxed);
+}
+
+qint64 QAVFrameCounters::filterRefs()
+{
+    return m_filterRefs.load(std::memory_order_relaxed);
+}
+
+void QAVFrameCounters::reset()
+{
+    m_refs = 0;
+    m_unrefs = 0;
+    m_filterRefs = 0;
+}
+
+QAVFramePrivate::QAVFramePrivate()
+    : frame(QAVFramePool::allocFrame())
+{
+}
+
+QAVFramePrivate::QAVFramePrivate(const QAVFramePrivate &other)
+    : QAVStreamFramePrivate(other)
+    , frame(QAVFramePool::allocFrame())
+    , frameRate(other.frameRate)
+    , timeBase(other.timeBase)
+    , filterName(other.filterName)
+{
+    if (other.frame->buf[0])
+        QAVFrameCounters::m_refs.fetch_add(1, std::memory_order_relaxed);
+    av_frame_ref(frame, other.frame);
+}
+
+QAVFramePrivate::~QAVFramePrivate()
+{
+    if (frame && frame->buf[0])
+        QAVFrameCounters::m_unrefs.fetch_add(1, std::memory_order_relaxed);
+    QAVFramePool::freeFrame(&frame);
+}
+
 QAVFrame::QAVFrame(QObject *parent)
     : QAVFrame(*new QAVFramePrivate, parent)
 {
 }
 
 QAVFrame::QAVFrame(const QAVFrame &other)
-    : QAVFrame()
+    : QAVStreamFrame(other)
+{
+}
+
+QAVFrame::QAVFrame(QAVFrame &&other) noexcept
+    : QAVStreamFrame(std::move(other))
 {
-    *this = other;
 }
 
 QAVFrame::QAVFrame(QAVFramePrivate &d, QObject *parent)
     : QAVStreamFrame(d, parent)
 {
-    d.frame = av_frame_alloc();
 }
 
 QAVFrame &QAVFrame::operator=(const QAVFrame &other)
 {
-    Q_D(QAVFrame);
     QAVStreamFrame::operator=(other);
+    return *this;
+}
 
-    auto other_priv = static_cast<QAVFramePrivate *>(other.d_ptr.get());
-    int64_t pts = d->frame->pts;
-    av_frame_unref(d->frame);
-    av_frame_ref(d->frame, other_priv->frame);
-
-    if (d->frame->pts < 0)
-        d->frame->pts = pts;
-
-    d->frameRate = other_priv->frameRate;
-    d->timeBase = other_priv->timeBase;
-    d->filterName = other_priv->filterName;
+QAVFrame &QAVFrame::operator=(QAVFrame &&other) noexcept
+{
+    QAVStreamFrame::operator=(std::move(other));
     return *this;
 }
 
@@ -60,11 +107,16 @@ QAVFrame::operator bool() const
 
 QAVFrame::~QAVFrame()
 {
+}
+
+AVFrame *QAVFrame::frame()
+{
+    detach();
     Q_D(QAVFrame);
-    av_frame_free(&d->frame);
+    return d->frame;
 }
 
-AVFrame *QAVFrame::frame() const
+const AVFrame *QAVFrame::frame() const
 {
     Q_D(const QAVFrame);
     return d->frame;
@@ -72,12 +124,14 @@ AVFrame *QAVFrame::frame() const
 
 void QAVFrame::setFrameRate(const AVRational &value)
 {
+    detach();
     Q_D(QAVFrame);
     d->frameRate = value;
 }
 
 void QAVFrame::setTimeBase(const AVRational &value)
 {
+    detach();
     Q_D(QAVFrame);
     d->timeBase = value;
 }
@@ -89,6 +143,7 @@ QString QAVFrame::filterName() const
 
 void QAVFrame::setFilterName(const QString &name)
 {
+    detach();
     Q_D(QAVFrame);
     d->filterName = name;
 }
@@ -16,15 +16,22 @@ QT_BEGIN_NAMESPACE
 struct AVFrame;
 struct AVRational;
 class QAVFramePrivate;
+// Implicitly shared: copies reference the same AVFrame instead of each one
+// owning its own reference to the buffers.
+// Assigning a frame copies its pts as is, even if it is not set
 class Q_AVPLAYER_EXPORT QAVFrame : public QAVStreamFrame
 {
 public:
     QAVFrame(QObject *parent = nullptr);
     ~QAVFrame();
     QAVFrame(const QAVFrame &other);
+    QAVFrame(QAVFrame &&other) noexcept;
     QAVFrame &operator=(const QAVFrame &other);
+    QAVFrame &operator=(QAVFrame &&other) noexcept;
     operator bool() const;
-    AVFrame *frame() const;
+    // Detaches from other copies, use the const overload to only read the frame
+    AVFrame *frame();
+    const AVFrame *frame() const;
 
     void setFrameRate(const AVRational &value);
     void setTimeBase(const AVRational &value);
@@ -36,6 +43,8 @@ protected:
     Q_DECLARE_PRIVATE(QAVFrame)
 };
 
+Q_DECLARE_TYPEINFO(QAVFrame, Q_MOVABLE_TYPE);
+
 QT_END_NAMESPACE
 
 #endif
@@ -20,6 +20,10 @@
 //
 
 #include "qavstreamframe_p.h"
+#include "qavaudioformat.h"
+#include <QMutex>
+#include <atomic>
+#include <memory>
 
 extern "C" {
 #include <libavutil/frame.h>
@@ -27,10 +31,43 @@ extern "C" {
 
 QT_BEGIN_NAMESPACE
 
+// Data derived from the frame on demand
+class QAVFrameData
+{
+public:
+    virtual ~QAVFrameData() = default;
+};
+
+// Counts references of the frame buffers taken and released by the frames,
+// used to measure copies of the data on the pipeline.
+// References taken by the filter sources are counted separately
+class Q_AVPLAYER_EXPORT QAVFrameCounters
+{
+public:
+    static qint64 refs();
+    static qint64 unrefs();
+    static qint64 filterRefs();
+    static void reset();
+
+private:
+    friend class QAVFramePrivate;
+    friend class QAVVideoFilter;
+    friend class QAVAudioFilter;
+    static std::atomic<qint64> m_refs;
+    static std::atomic<qint64> m_unrefs;
+    static std::atomic<qint64> m_filterRefs;
+};
+
 struct AVFrame;
 class QAVFramePrivate : public QAVStreamFramePrivate
 {
 public:
+    QAVFramePrivate();
+    // References the same buffers, derived data is not copied
+    QAVFramePrivate(const QAVFramePrivate &other);
+    ~QAVFramePrivate();
+    QAVStreamFramePrivate *clone() const override { return new QAVFramePrivate(*this); }
+    QAVStreamFramePrivate *empty() const override { return qavEmptyFramePrivate<QAVFramePrivate>(); }
 
     double pts() const override;
     double duration() const override;
@@ -41,6 +78,12 @@ public:
     AVRational timeBase{};
     // Name of a filter the frame has retrieved from
     QString filterName;
+
+    // Mapped video buffer and converted audio samples, shared by all copies
+    mutable QMutex dataMutex;
+    mutable std::unique_ptr<QAVFrameData> videoData;
+    mutable QAVAudioFormat audioFormat;
+    mutable QByteArray audioData;
 };
 
 QT_END_NAMESPACE
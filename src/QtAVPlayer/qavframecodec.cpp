@@ -41,6 +41,7 @@ int QAVFrameCodec::read(QAVStreamFrame &frame)
     if (!d->avctx)
         return AVERROR(EINVAL);
     auto f = static_cast<QAVFrame *>(&frame);
+    // Other copies are not overwritten, frame() detaches
     return avcodec_receive_frame(d->avctx, f->frame());
 }
 
@@ -0,0 +1,299 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavframepool_p.h"
+#include <QVector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+// Size of the allocation is kept in front of the data, keeping its alignment
+static const int headerSize = 64;
+// Decoders may read or write slightly beyond the planes
+static const int paddingSize = 64;
+
+QAVFramePool::QAVFramePool(qint64 maxBytes)
+    : m_maxBytes(maxBytes)
+{
+}
+
+QAVFramePool::~QAVFramePool()
+{
+}
+
+QAVFramePool *QAVFramePool::create(qint64 maxBytes)
+{
+    return maxBytes > 0 ? new QAVFramePool(maxBytes) : nullptr;
+}
+
+void QAVFramePool::release()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        // Buffers still used by frames are freed when returned
+        for (auto &pool : m_pools)
+            av_buffer_pool_uninit(&pool);
+        m_pools.clear();
+    }
+    deref();
+}
+
+void QAVFramePool::ref()
+{
+    ++m_refs;
+}
+
+void QAVFramePool::deref()
+{
+    if (--m_refs == 0)
+        delete this;
+}
+
+AVBufferRef *QAVFramePool::alloc(void *opaque, BufferSize size)
+{
+    auto p = static_cast<QAVFramePool *>(opaque);
+    const qint64 bytes = p->m_bytes.fetch_add(qint64(size)) + qint64(size);
+    if (bytes > p->m_maxBytes) {
+        p->m_bytes -= qint64(size);
+        return nullptr;
+    }
+
+    uint8_t *mem = static_cast<uint8_t *>(av_malloc(size + headerSize));
+    if (!mem) {
+        p->m_bytes -= qint64(size);
+        return nullptr;
+    }
+
+    *reinterpret_cast<qint64 *>(mem) = qint64(size);
+    AVBufferRef *buf = av_buffer_create(mem + headerSize, size, &QAVFramePool::freeBuffer, p, 0);
+    if (!buf) {
+        av_free(mem);
+        p->m_bytes -= qint64(size);
+        return nullptr;
+    }
+
+    p->ref();
+    ++p->m_misses;
+    qint64 high = p->m_highWaterBytes;
+    while (bytes > high && !p->m_highWaterBytes.compare_exchange_weak(high, bytes)) {}
+    return buf;
+}
+
+void QAVFramePool::freeBuffer(void *opaque, uint8_t *data)
+{
+    auto p = static_cast<QAVFramePool *>(opaque);
+    uint8_t *mem = data - headerSize;
+    p->m_bytes -= *reinterpret_cast<qint64 *>(mem);
+    av_free(mem);
+    p->deref();
+}
+
+AVBufferRef *QAVFramePool::get(int size)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_pools.find(size);
+    if (it == m_pools.end()) {
+        // Only the current size is kept
+        for (auto &pool : m_pools)
+            av_buffer_pool_uninit(&pool);
+        m_pools.clear();
+        it = m_pools.insert(size, av_buffer_pool_init2(size, this, &QAVFramePool::alloc, nullptr));
+    }
+    AVBufferPool *pool = it.value();
+    locker.unlock();
+
+    ++m_requests;
+    AVBufferRef *buf = pool ? av_buffer_pool_get(pool) : nullptr;
+    if (!buf)
+        ++m_fallbacks;
+    return buf;
+}
+
+int QAVFramePool::getVideoBuffer(AVCodecContext *avctx, AVFrame *frame)
+{
+    const AVPixelFormat fmt = AVPixelFormat(frame->format);
+    int w = frame->width;
+    int h = frame->height;
+    int align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(avctx, &w, &h, align);
+
+    // Increases the width until all linesizes are aligned
+    int linesize[4] = {0};
+    int unaligned = 0;
+    do {
+        if (av_image_fill_linesizes(linesize, fmt, w) < 0)
+            return 1;
+        w += w & ~(w - 1);
+        unaligned = 0;
+        for (int i = 0; i < 4; ++i)
+            unaligned |= align[i] ? linesize[i] % align[i] : 0;
+    } while (unaligned);
+
+    uint8_t *data[4] = {nullptr};
+    const int size = av_image_fill_pointers(data, fmt, h, nullptr, linesize);
+    if (size < 0)
+        return 1;
+
+    AVBufferRef *buf = get(size + paddingSize);
+    if (!buf)
+        return 1;
+
+    av_image_fill_pointers(frame->data, fmt, h, buf->data, linesize);
+    for (int i = 0; i < 4; ++i)
+        frame->linesize[i] = linesize[i];
+    frame->buf[0] = buf;
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+QAVFramePoolStatistics QAVFramePool::statistics() const
+{
+    QAVFramePoolStatistics s;
+    s.misses = m_misses;
+    s.fallbacks = m_fallbacks;
+    s.hits = qMax<qint64>(0, m_requests - s.misses - s.fallbacks);
+    s.bytes = m_bytes;
+    s.highWaterBytes = m_highWaterBytes;
+    return s;
+}
+
+// Shells shared by all threads, moved in batches to keep the lock rare
+template <typename T>
+class QAVShellPool
+{
+public:
+    using Free = void (*)(T **);
+    explicit QAVShellPool(Free free) : m_free(free) { }
+    ~QAVShellPool()
+    {
+        for (auto s : m_shells)
+            m_free(&s);
+    }
+
+    void take(QVector<T *> &shells, int count)
+    {
+        QMutexLocker locker(&m_mutex);
+        count = qMin(count, int(m_shells.size()));
+        for (int i = 0; i < count; ++i)
+            shells.append(m_shells.takeLast());
+    }
+
+    // Frees the shells which do not fit
+    void put(QVector<T *> &shells, int count)
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int i = 0; i < count && !shells.isEmpty(); ++i) {
+            T *shell = shells.takeLast();
+            if (m_shells.size() < maxShells)
+                m_shells.append(shell);
+            else
+                m_free(&shell);
+        }
+    }
+
+private:
+    static const int maxShells = 256;
+    Free m_free = nullptr;
+    QMutex m_mutex;
+    QVector<T *> m_shells;
+};
+
+// Shells of the current thread, frames are often freed by another thread
+// than the decoding one, so the batches flow back through the shared pool
+template <typename T>
+class QAVShellCache
+{
+public:
+    explicit QAVShellCache(QAVShellPool<T> &pool) : m_pool(pool) { }
+    ~QAVShellCache()
+    {
+        m_pool.put(m_shells, m_shells.size());
+    }
+
+    T *take()
+    {
+        if (m_shells.isEmpty())
+            m_pool.take(m_shells, batchSize);
+        return !m_shells.isEmpty() ? m_shells.takeLast() : nullptr;
+    }
+
+    void put(T *shell)
+    {
+        if (m_shells.size() >= maxShells)
+            m_pool.put(m_shells, batchSize);
+        m_shells.append(shell);
+    }
+
+private:
+    static const int batchSize = 16;
+    static const int maxShells = 2 * batchSize;
+    QAVShellPool<T> &m_pool;
+    QVector<T *> m_shells;
+};
+
+static QAVShellPool<AVFrame> &framePool()
+{
+    static QAVShellPool<AVFrame> pool(&av_frame_free);
+    return pool;
+}
+
+static QAVShellPool<AVPacket> &packetPool()
+{
+    static QAVShellPool<AVPacket> pool(&av_packet_free);
+    return pool;
+}
+
+static QAVShellCache<AVFrame> &frameCache()
+{
+    static thread_local QAVShellCache<AVFrame> cache(framePool());
+    return cache;
+}
+
+static QAVShellCache<AVPacket> &packetCache()
+{
+    static thread_local QAVShellCache<AVPacket> cache(packetPool());
+    return cache;
+}
+
+AVFrame *QAVFramePool::allocFrame()
+{
+    AVFrame *frame = frameCache().take();
+    return frame ? frame : av_frame_alloc();
+}
+
+void QAVFramePool::freeFrame(AVFrame **frame)
+{
+    if (!frame || !*frame)
+        return;
+
+    av_frame_unref(*frame);
+    frameCache().put(*frame);
+    *frame = nullptr;
+}
+
+AVPacket *QAVFramePool::allocPacket()
+{
+    AVPacket *pkt = packetCache().take();
+    return pkt ? pkt : av_packet_alloc();
+}
+
+void QAVFramePool::freePacket(AVPacket **pkt)
+{
+    if (!pkt || !*pkt)
+        return;
+
+    av_packet_unref(*pkt);
+    packetCache().put(*pkt);
+    *pkt = nullptr;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,99 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVFRAMEPOOL_P_H
+#define QAVFRAMEPOOL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QMutex>
+#include <QMap>
+#include <atomic>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/version.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+struct QAVFramePoolStatistics
+{
+    // Buffers reused from the pool
+    qint64 hits = 0;
+    // Buffers allocated by the pool
+    qint64 misses = 0;
+    // Buffers allocated by the default allocator since the pool is full
+    qint64 fallbacks = 0;
+    qint64 bytes = 0;
+    qint64 highWaterBytes = 0;
+};
+
+// Picture buffers of one decoder, bucketed by size and limited by maxBytes.
+// Buckets of previous sizes are released when the size changes
+class QAVFramePool
+{
+public:
+    static QAVFramePool *create(qint64 maxBytes);
+    void release();
+
+    // Returns a positive value if the frame should be allocated by the default allocator
+    int getVideoBuffer(AVCodecContext *avctx, AVFrame *frame);
+    QAVFramePoolStatistics statistics() const;
+
+    // Reuses AVFrame and AVPacket shells, cached per thread
+    static AVFrame *allocFrame();
+    static void freeFrame(AVFrame **frame);
+    static AVPacket *allocPacket();
+    static void freePacket(AVPacket **pkt);
+
+private:
+    explicit QAVFramePool(qint64 maxBytes);
+    ~QAVFramePool();
+    Q_DISABLE_COPY(QAVFramePool)
+
+    void ref();
+    void deref();
+    AVBufferRef *get(int size);
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+    using BufferSize = size_t;
+#else
+    using BufferSize = int;
+#endif
+    static AVBufferRef *alloc(void *opaque, BufferSize size);
+    static void freeBuffer(void *opaque, uint8_t *data);
+
+    const qint64 m_maxBytes = 0;
+    std::atomic<int> m_refs { 1 };
+    QMutex m_mutex;
+    QMap<int, AVBufferPool *> m_pools;
+
+    std::atomic<qint64> m_requests { 0 };
+    std::atomic<qint64> m_misses { 0 };
+    std::atomic<qint64> m_fallbacks { 0 };
+    std::atomic<qint64> m_bytes { 0 };
+    std::atomic<qint64> m_highWaterBytes { 0 };
+};
+
+QT_END_NAMESPACE
+
+#endif
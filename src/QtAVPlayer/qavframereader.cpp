@@ -0,0 +1,294 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavframereader.h"
+#include "qavdemuxer_p.h"
+#include "qavpacket_p.h"
+#include "qavfilters_p.h"
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+class QAVFrameReaderPrivate
+{
+public:
+    QList<QAVFrame> &frames(AVMediaType type)
+    {
+        return type == AVMEDIA_TYPE_VIDEO ? videoFrames : audioFrames;
+    }
+
+    bool &isRead(AVMediaType type)
+    {
+        return type == AVMEDIA_TYPE_VIDEO ? videoRead : audioRead;
+    }
+
+    QAVFrame read(AVMediaType type);
+    void readPacket();
+    void drain();
+    void filter(AVMediaType type, QAVFrame &&frame);
+    void append(AVMediaType type, QList<QAVFrame> &&filtered);
+
+    QAVDemuxer demuxer;
+    QList<QString> filterDescs;
+    QAVFilters filters;
+    QList<QAVFrame> videoFrames;
+    QList<QAVFrame> audioFrames;
+    // Frames are kept only for the types read since load()
+    bool videoRead = false;
+    bool audioRead = false;
+    bool eof = false;
+    int maxFrames = 64;
+    qint64 droppedFrames = 0;
+};
+
+QAVFrame QAVFrameReaderPrivate::read(AVMediaType type)
+{
+    isRead(type) = true;
+    auto &result = frames(type);
+    while (result.isEmpty() && !eof)
+        readPacket();
+    return !result.isEmpty() ? result.takeFirst() : QAVFrame();
+}
+
+void QAVFrameReaderPrivate::append(AVMediaType type, QList<QAVFrame> &&filtered)
+{
+    if (!isRead(type))
+        return;
+
+    auto &result = frames(type);
+    result += filtered;
+    if (maxFrames > 0 && result.size() > maxFrames) {
+        const int dropped = result.size() - maxFrames;
+        qWarning() << "Dropped" << dropped << av_get_media_type_string(type) << "frames not read";
+        droppedFrames += dropped;
+        result.erase(result.begin(), result.end() - maxFrames);
+    }
+}
+
+void QAVFrameReaderPrivate::readPacket()
+{
+    QAVPacket pkt = demuxer.read();
+    if (!pkt.stream()) {
+        drain();
+        eof = true;
+        return;
+    }
+
+    const auto type = demuxer.currentCodecType(pkt.packet()->stream_index);
+    if (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO)
+        return;
+
+    QList<QAVFrame> decoded;
+    demuxer.decode(pkt, decoded);
+    for (auto &frame : decoded)
+        filter(type, std::move(frame));
+}
+
+// Returns frames buffered by the codecs and the filters
+void QAVFrameReaderPrivate::drain()
+{
+    const auto streams = demuxer.currentVideoStreams() + demuxer.currentAudioStreams();
+    for (const auto &stream : streams) {
+        QAVPacket pkt;
+        pkt.setStream(stream);
+        QList<QAVFrame> decoded;
+        demuxer.decode(pkt, decoded);
+        for (auto &frame : decoded)
+            filter(stream.stream()->codecpar->codec_type, std::move(frame));
+    }
+
+    filters.flush();
+    for (auto type : { AVMEDIA_TYPE_VIDEO, AVMEDIA_TYPE_AUDIO }) {
+        QList<QAVFrame> filtered;
+        filters.read(type, QAVFrame(), filtered);
+        append(type, std::move(filtered));
+    }
+}
+
+void QAVFrameReaderPrivate::filter(AVMediaType type, QAVFrame &&frame)
+{
+    int ret = filters.write(type, std::move(frame));
+    // Not supported frames are not taken, the filters are created for them
+    if (ret == AVERROR(ENOTSUP)) {
+        ret = filters.createFilters(filterDescs, frame, demuxer);
+        if (ret >= 0)
+            ret = filters.write(type, std::move(frame));
+    }
+    QList<QAVFrame> filtered;
+    if (ret >= 0 || ret == AVERROR(EAGAIN))
+        ret = filters.read(type, std::move(frame), filtered);
+    if (ret < 0 && ret != AVERROR(EAGAIN))
+        qWarning() << "Could not filter the frame:" << ret;
+    append(type, std::move(filtered));
+}
+
+QAVFrameReader::QAVFrameReader()
+    : d_ptr(new QAVFrameReaderPrivate)
+{
+}
+
+QAVFrameReader::~QAVFrameReader()
+{
+}
+
+int QAVFrameReader::load(const QString &url)
+{
+    Q_D(QAVFrameReader);
+    unload();
+    int ret = d->demuxer.load(url);
+    if (ret < 0)
+        return ret;
+
+    if (d->demuxer.currentVideoStreams().isEmpty() && d->demuxer.currentAudioStreams().isEmpty()) {
+        qWarning() << "No video or audio stream found:" << url;
+        d->demuxer.unload();
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+
+    ret = d->filters.createFilters(d->filterDescs, {}, d->demuxer);
+    if (ret < 0) {
+        d->demuxer.unload();
+        return ret;
+    }
+
+    return 0;
+}
+
+void QAVFrameReader::unload()
+{
+    Q_D(QAVFrameReader);
+    d->filters.clear();
+    d->videoFrames.clear();
+    d->audioFrames.clear();
+    d->videoRead = false;
+    d->audioRead = false;
+    d->droppedFrames = 0;
+    d->demuxer.unload();
+    d->eof = false;
+}
+
+double QAVFrameReader::duration() const
+{
+    return d_func()->demuxer.duration();
+}
+
+QList<QAVStream> QAVFrameReader::availableVideoStreams() const
+{
+    return d_func()->demuxer.availableVideoStreams();
+}
+
+QList<QAVStream> QAVFrameReader::currentVideoStreams() const
+{
+    return d_func()->demuxer.currentVideoStreams();
+}
+
+bool QAVFrameReader::setVideoStreams(const QList<QAVStream> &streams)
+{
+    Q_D(QAVFrameReader);
+    d->videoFrames.clear();
+    return d->demuxer.setVideoStreams(streams);
+}
+
+QList<QAVStream> QAVFrameReader::availableAudioStreams() const
+{
+    return d_func()->demuxer.availableAudioStreams();
+}
+
+QList<QAVStream> QAVFrameReader::currentAudioStreams() const
+{
+    return d_func()->demuxer.currentAudioStreams();
+}
+
+bool QAVFrameReader::setAudioStreams(const QList<QAVStream> &streams)
+{
+    Q_D(QAVFrameReader);
+    d->audioFrames.clear();
+    return d->demuxer.setAudioStreams(streams);
+}
+
+QList<QString> QAVFrameReader::filters() const
+{
+    return d_func()->filterDescs;
+}
+
+int QAVFrameReader::setFilters(const QList<QString> &filters)
+{
+    Q_D(QAVFrameReader);
+    if (!d->demuxer.currentVideoStreams().isEmpty() || !d->demuxer.currentAudioStreams().isEmpty()) {
+        int ret = d->filters.createFilters(filters, {}, d->demuxer);
+        if (ret < 0) {
+            // Keeps the previous filters working
+            d->filters.createFilters(d->filterDescs, {}, d->demuxer);
+            return ret;
+        }
+    }
+    d->filterDescs = filters;
+    return 0;
+}
+
+int QAVFrameReader::decodingThreads() const
+{
+    return d_func()->demuxer.decodingThreads();
+}
+
+void QAVFrameReader::setDecodingThreads(int threads)
+{
+    d_func()->demuxer.setDecodingThreads(threads);
+}
+
+int QAVFrameReader::maxBufferedFrames() const
+{
+    return d_func()->maxFrames;
+}
+
+void QAVFrameReader::setMaxBufferedFrames(int frames)
+{
+    d_func()->maxFrames = qMax(0, frames);
+}
+
+qint64 QAVFrameReader::droppedFrames() const
+{
+    return d_func()->droppedFrames;
+}
+
+int QAVFrameReader::seek(double sec)
+{
+    Q_D(QAVFrameReader);
+    int ret = d->demuxer.seek(sec);
+    if (ret < 0)
+        return ret;
+
+    d->demuxer.flushCodecBuffers();
+    d->videoFrames.clear();
+    d->audioFrames.clear();
+    d->eof = false;
+    return d->filters.createFilters(d->filterDescs, {}, d->demuxer);
+}
+
+QAVVideoFrame QAVFrameReader::readVideoFrame()
+{
+    Q_D(QAVFrameReader);
+    return d->read(AVMEDIA_TYPE_VIDEO);
+}
+
+QAVAudioFrame QAVFrameReader::readAudioFrame()
+{
+    Q_D(QAVFrameReader);
+    return d->read(AVMEDIA_TYPE_AUDIO);
+}
+
+bool QAVFrameReader::atEnd() const
+{
+    Q_D(const QAVFrameReader);
+    return d->eof && d->videoFrames.isEmpty() && d->audioFrames.isEmpty();
+}
+
+QT_END_NAMESPACE
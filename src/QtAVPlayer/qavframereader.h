@@ -0,0 +1,80 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVFRAMEREADER_H
+#define QAVFRAMEREADER_H
+
+#include <QtAVPlayer/qavvideoframe.h>
+#include <QtAVPlayer/qavaudioframe.h>
+#include <QtAVPlayer/qavstream.h>
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QList>
+#include <QString>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+// Reads frames synchronously on the calling thread, without clocks or signals.
+// Each reader is used by one thread at a time, many readers can work in parallel.
+// Frames of a type are dropped until it is read once after load(), then the frames
+// of the other type are kept until read. Disable unused streams to avoid decoding them
+class QAVFrameReaderPrivate;
+class Q_AVPLAYER_EXPORT QAVFrameReader
+{
+public:
+    QAVFrameReader();
+    ~QAVFrameReader();
+
+    int load(const QString &url);
+    void unload();
+
+    double duration() const;
+
+    QList<QAVStream> availableVideoStreams() const;
+    QList<QAVStream> currentVideoStreams() const;
+    bool setVideoStreams(const QList<QAVStream> &streams);
+
+    QList<QAVStream> availableAudioStreams() const;
+    QList<QAVStream> currentAudioStreams() const;
+    bool setAudioStreams(const QList<QAVStream> &streams);
+
+    // Recreates the filters, the frames already decoded are not filtered.
+    // The previous filters are kept if the new ones could not be created
+    QList<QString> filters() const;
+    int setFilters(const QList<QString> &filters);
+
+    // 0 means auto detect, applied on next load()
+    int decodingThreads() const;
+    void setDecodingThreads(int threads);
+
+    // Frames of a type kept while reading the other type, 0 means no limit.
+    // The oldest frames are dropped above the limit
+    int maxBufferedFrames() const;
+    void setMaxBufferedFrames(int frames);
+    // Frames dropped above the limit since load()
+    qint64 droppedFrames() const;
+
+    // Seeks to the nearest keyframe before sec and drops the decoded frames
+    int seek(double sec);
+
+    // Frames are returned in the order they are decoded,
+    // null frame means no more frames of this type
+    QAVVideoFrame readVideoFrame();
+    QAVAudioFrame readAudioFrame();
+    bool atEnd() const;
+
+protected:
+    std::unique_ptr<QAVFrameReaderPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVFrameReader)
+    Q_DECLARE_PRIVATE(QAVFrameReader)
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -8,6 +8,10 @@
 #include "qaviodevice_p.h"
 #include <QMutex>
 #include <QWaitCondition>
+#include <QThread>
+#include <QDebug>
+#include <atomic>
+#include <thread>
 
 extern "C" {
 #include <libavformat/avio.h>
@@ -29,19 +33,37 @@ class QAVIODevicePrivate
 {
     Q_DECLARE_PUBLIC(QAVIODevice)
 public:
-    explicit QAVIODevicePrivate(QAVIODevice *q, QIODevice &device)
+    explicit QAVIODevicePrivate(QAVIODevice *q, QIODevice *device)
         : q_ptr(q)
         , device(device)
-        , buffer(static_cast<unsigned char*>(av_malloc(buffer_size)))
-        , ctx(avio_alloc_context(buffer, buffer_size, 0, this, &QAVIODevicePrivate::read, nullptr, !device.isSequential() ? &QAVIODevicePrivate::seek : nullptr))
     {
-        if (!device.isSequential())
-            ctx->seekable = AVIO_SEEKABLE_NORMAL;
     }
 
     ~QAVIODevicePrivate()
     {
-        av_free(ctx);
+        stopFiller();
+        if (ctx) {
+            av_freep(&ctx->buffer);
+            av_free(ctx);
+        }
+    }
+
+    AVIOContext *context()
+    {
+        if (!ctx && !device) {
+            // Large reads bypass the buffer and are copied directly from the memory
+            auto buffer = static_cast<unsigned char*>(av_malloc(bufferSize));
+            ctx = avio_alloc_context(buffer, bufferSize, 0, this, &QAVIODevicePrivate::readMemory, nullptr, &QAVIODevicePrivate::seekMemory);
+            ctx->seekable = AVIO_SEEKABLE_NORMAL;
+            ctx->direct = 1;
+        }
+        if (!ctx) {
+            auto buffer = static_cast<unsigned char*>(av_malloc(bufferSize));
+            ctx = avio_alloc_context(buffer, bufferSize, 0, this, &QAVIODevicePrivate::read, nullptr, !device->isSequential() ? &QAVIODevicePrivate::seek : nullptr);
+            if (!device->isSequential())
+                ctx->seekable = AVIO_SEEKABLE_NORMAL;
+        }
+        return ctx;
     }
 
     void readData()
@@ -51,7 +73,7 @@ public:
         if (readRequest.data == nullptr || readRequest.wroteBytes)
             return;
 
-        readRequest.wroteBytes = !device.atEnd() ? device.read((char *)readRequest.data, readRequest.maxSize) : AVERROR_EOF;
+        readRequest.wroteBytes = !device->atEnd() ? device->read((char *)readRequest.data, readRequest.maxSize) : AVERROR_EOF;
         // Unblock the decoder thread when there is available bytes
         if (readRequest.wroteBytes) {
             waitCond.wakeAll();
@@ -66,6 +88,16 @@ public:
         if (d->aborted)
             return ECANCELED;
 
+        if (d->isReadAhead()) {
+            locker.unlock();
+            return d->readCached(data, maxSize);
+        }
+
+        if (d->directRead) {
+            locker.unlock();
+            return d->readDirect(data, maxSize);
+        }
+
         d->readRequest = { data, maxSize };
         // When decoder thread is the same as current
         d->wakeRead = false;
@@ -89,54 +121,391 @@ public:
         if (d->aborted)
             return ECANCELED;
 
-        int64_t pos = 0;
-        bool wake = false;
         locker.unlock();
-        QMetaObject::invokeMethod(d->q_ptr, [&] {
-            QMutexLocker locker(&d->mutex);
-            if (whence == AVSEEK_SIZE) {
-                pos = d->device.size() > 0 ? d->device.size() : 0;
-            } else {
-                if (whence == SEEK_END)
-                    offset = d->device.size() - offset;
-                else if (whence == SEEK_CUR)
-                    offset = d->device.pos() + offset;
+        const int origin = whence & ~AVSEEK_FORCE;
+        if (d->isReadAhead() && (origin == SEEK_SET || origin == SEEK_CUR))
+            return d->seekCached(offset, origin);
+
+        int64_t pos = 0;
+        if (d->directRead) {
+            QMutexLocker deviceLocker(&d->deviceMutex);
+            pos = d->seekDevice(offset, whence);
+        } else {
+            bool wake = false;
+            QMetaObject::invokeMethod(d->q_ptr, [&] {
+                QMutexLocker locker(&d->mutex);
+                pos = d->seekDevice(offset, whence);
+                d->waitCond.wakeAll();
+                wake = true;
+            }, nullptr);
+
+            locker.relock();
+            if (!wake)
+                d->waitCond.wait(&d->mutex);
+            locker.unlock();
+        }
+
+        // Cached bytes are not valid anymore when the device is moved
+        if (pos >= 0 && whence != AVSEEK_SIZE && d->isReadAhead()) {
+            locker.relock();
+            d->resetCache(pos);
+        }
 
-                pos = d->device.seek(offset) ? d->device.pos() : -1;
+        return pos;
+    }
+
+    static int readMemory(void *opaque, unsigned char *data, int maxSize)
+    {
+        auto d = static_cast<QAVIODevicePrivate *>(opaque);
+        if (d->aborted)
+            return AVERROR_EXIT;
+
+        const qint64 bytes = qMin<qint64>(maxSize, d->memorySize - d->memoryPos);
+        if (bytes <= 0)
+            return AVERROR_EOF;
+
+        memcpy(data, d->memoryData + d->memoryPos, bytes);
+        d->memoryPos += bytes;
+        return int(bytes);
+    }
+
+    static int64_t seekMemory(void *opaque, int64_t offset, int whence)
+    {
+        auto d = static_cast<QAVIODevicePrivate *>(opaque);
+        int64_t pos = 0;
+        switch (whence & ~AVSEEK_FORCE) {
+            case AVSEEK_SIZE:
+                return d->memorySize;
+            case SEEK_SET:
+                pos = offset;
+                break;
+            case SEEK_CUR:
+                pos = d->memoryPos + offset;
+                break;
+            case SEEK_END:
+                pos = d->memorySize + offset;
+                break;
+            default:
+                return AVERROR(EINVAL);
+        }
+
+        if (pos < 0 || pos > d->memorySize)
+            return AVERROR(EINVAL);
+
+        d->memoryPos = pos;
+        return pos;
+    }
+
+    int64_t seekDevice(int64_t offset, int whence)
+    {
+        if (whence == AVSEEK_SIZE)
+            return device->size() > 0 ? device->size() : 0;
+
+        if (whence == SEEK_END)
+            offset = device->size() - offset;
+        else if (whence == SEEK_CUR)
+            offset = device->pos() + offset;
+
+        return device->seek(offset) ? device->pos() : -1;
+    }
+
+    // Reads on the calling thread, waits for readyRead if sequential devices have no data
+    int readDirect(unsigned char *data, int maxSize)
+    {
+        QMutexLocker locker(&mutex);
+        while (!aborted) {
+            deviceReady = false;
+            locker.unlock();
+            qint64 bytes = 0;
+            {
+                QMutexLocker deviceLocker(&deviceMutex);
+                if (device->atEnd() && !device->isSequential())
+                    return AVERROR_EOF;
+
+                bytes = device->read(reinterpret_cast<char *>(data), maxSize);
+                if (bytes > 0)
+                    return int(bytes);
+                if (bytes < 0 || !device->isOpen())
+                    return AVERROR_EOF;
             }
-            d->waitCond.wakeAll();
-            wake = true;
-        }, nullptr);
 
-        locker.relock();
-        if (!wake)
-            d->waitCond.wait(&d->mutex);
+            locker.relock();
+            if (!deviceReady && !aborted)
+                waitCond.wait(&mutex);
+        }
+
+        return AVERROR_EXIT;
+    }
+
+    // Called by readyRead on the owner thread
+    void wakeDirectRead()
+    {
+        QMutexLocker locker(&mutex);
+        deviceReady = true;
+        waitCond.wakeAll();
+        cacheCond.wakeAll();
+    }
+
+    bool isReadAhead() const
+    {
+        return readAheadBytes > 0 || readAheadDuration > 0;
+    }
+
+    qint64 readAheadLimit() const
+    {
+        qint64 limit = readAheadBytes;
+        if (readAheadDuration > 0) {
+            // Bit rate is known only after the input is opened
+            const qint64 bytes = bitRate > 0 ? bitRate / 8 * readAheadDuration / 1000 : qint64(bufferSize) * 4;
+            limit = limit > 0 ? qMin(limit, bytes) : bytes;
+        }
+        return qMax<qint64>(limit, bufferSize);
+    }
+
+    qint64 cached() const
+    {
+        return cache.size() - cacheOffset;
+    }
+
+    void resetCache(qint64 pos)
+    {
+        cache.clear();
+        cacheOffset = 0;
+        cachePos = pos;
+        cacheEof = false;
+        ++generation;
+        cacheCond.wakeAll();
+    }
+
+    void consumeCache(qint64 bytes)
+    {
+        cacheOffset += bytes;
+        cachePos += bytes;
+        // Avoids moving the bytes on every read
+        if (cacheOffset >= cache.size() / 2) {
+            cache.remove(0, cacheOffset);
+            cacheOffset = 0;
+        }
+    }
+
+    // Serves the reads from memory, the cache is filled in background
+    int readCached(unsigned char *data, int maxSize)
+    {
+        QMutexLocker locker(&mutex);
+        while (!aborted && !cached() && !cacheEof) {
+            if (directRead) {
+                startFiller();
+            } else if (QThread::currentThread() == q_ptr->thread()) {
+                locker.unlock();
+                fillOnOwner();
+                locker.relock();
+                continue;
+            } else {
+                requestFill();
+            }
+            cacheCond.wait(&mutex);
+        }
 
+        if (aborted)
+            return AVERROR_EXIT;
+        if (!cached())
+            return AVERROR_EOF;
+
+        const int bytes = int(qMin<qint64>(maxSize, cached()));
+        memcpy(data, cache.constData() + cacheOffset, bytes);
+        consumeCache(bytes);
+        if (directRead)
+            cacheCond.wakeAll();
+        else
+            requestFill();
+        return bytes;
+    }
+
+    int64_t seekCached(int64_t offset, int origin)
+    {
+        QMutexLocker locker(&mutex);
+        const qint64 pos = origin == SEEK_CUR ? cachePos + offset : offset;
+        if (pos < 0)
+            return AVERROR(EINVAL);
+
+        // Seeking forward within the cache just skips the bytes
+        if (pos >= cachePos && pos <= cachePos + cached())
+            consumeCache(pos - cachePos);
+        else
+            resetCache(pos);
+
+        if (directRead)
+            cacheCond.wakeAll();
         return pos;
     }
 
-    const size_t buffer_size = 64 * 1024;
+    void requestFill()
+    {
+        if (fillRequested || aborted)
+            return;
+        fillRequested = true;
+        QMetaObject::invokeMethod(q_ptr, [this] { fillOnOwner(); }, Qt::QueuedConnection);
+    }
+
+    // Fills the cache on the owner thread up to the limit,
+    // the reader is woken after every chunk
+    void fillOnOwner()
+    {
+        QMutexLocker locker(&mutex);
+        fillRequested = false;
+        while (true) {
+            const qint64 room = readAheadLimit() - cached();
+            if (aborted || cacheEof || room <= 0)
+                return;
+
+            const qint64 pos = cachePos + cached();
+            const quint64 gen = generation;
+            locker.unlock();
+
+            if (!device->isSequential() && device->pos() != pos)
+                device->seek(pos);
+            qint64 size = qMin<qint64>(room, bufferSize);
+            if (device->isSequential())
+                size = qMin(size, device->bytesAvailable());
+            QByteArray chunk(int(qMax<qint64>(size, 0)), Qt::Uninitialized);
+            const qint64 bytes = size > 0 ? device->read(chunk.data(), size) : 0;
+            const bool eof = bytes < 0 || (bytes == 0 && device->atEnd());
+
+            locker.relock();
+            // Seeked meanwhile, filled from the new position
+            if (gen != generation)
+                continue;
+
+            if (bytes > 0)
+                cache.append(chunk.constData(), int(bytes));
+            cacheEof = eof;
+            cacheCond.wakeAll();
+            // Sequential devices are continued by readyRead
+            if (bytes <= 0)
+                return;
+        }
+    }
+
+    void startFiller()
+    {
+        if (filler.joinable())
+            return;
+        stopFilling = false;
+        filler = std::thread([this] { fillLoop(); });
+    }
+
+    void stopFiller()
+    {
+        {
+            QMutexLocker locker(&mutex);
+            stopFilling = true;
+            cacheCond.wakeAll();
+        }
+        if (filler.joinable())
+            filler.join();
+    }
+
+    // Reads ahead on a separate thread for devices which do not need the owner thread
+    void fillLoop()
+    {
+        QMutexLocker locker(&mutex);
+        while (!stopFilling) {
+            const qint64 room = readAheadLimit() - cached();
+            if (aborted || cacheEof || room <= 0) {
+                cacheCond.wait(&mutex);
+                continue;
+            }
+
+            const qint64 pos = cachePos + cached();
+            const quint64 gen = generation;
+            deviceReady = false;
+            locker.unlock();
+
+            QByteArray chunk(int(qMin<qint64>(room, bufferSize)), Qt::Uninitialized);
+            qint64 bytes = 0;
+            bool eof = false;
+            {
+                QMutexLocker deviceLocker(&deviceMutex);
+                if (!device->isSequential() && device->pos() != pos)
+                    device->seek(pos);
+                bytes = device->read(chunk.data(), chunk.size());
+                eof = bytes < 0 || (bytes == 0 && (!device->isSequential() || device->atEnd()));
+            }
+
+            locker.relock();
+            // Sequential devices are continued by readyRead
+            if (bytes == 0 && !eof) {
+                if (!deviceReady && !stopFilling && !aborted)
+                    cacheCond.wait(&mutex);
+                continue;
+            }
+            if (gen != generation)
+                continue;
+
+            if (bytes > 0)
+                cache.append(chunk.constData(), int(bytes));
+            cacheEof = eof;
+            cacheCond.wakeAll();
+        }
+    }
+
+    int bufferSize = 64 * 1024;
     QAVIODevice *q_ptr = nullptr;
-    QIODevice &device;
-    unsigned char *buffer = nullptr;
+    QIODevice *device = nullptr;
+    // Memory source is read without any device
+    const uchar *memoryData = nullptr;
+    qint64 memorySize = 0;
+    qint64 memoryPos = 0;
     AVIOContext *ctx = nullptr;
     QMutex mutex;
     QWaitCondition waitCond;
-    bool aborted = false;
+    std::atomic<bool> aborted { false };
+    std::atomic<bool> directRead { false };
     bool wakeRead = false;
     ReadRequest readRequest;
+    // New data is signaled for the direct reads
+    bool deviceReady = false;
+
+    // Read-ahead cache starting at cachePos of the device
+    qint64 readAheadBytes = 0;
+    qint64 readAheadDuration = 0;
+    std::atomic<qint64> bitRate { 0 };
+    QByteArray cache;
+    int cacheOffset = 0;
+    qint64 cachePos = 0;
+    bool cacheEof = false;
+    quint64 generation = 0;
+    bool fillRequested = false;
+    QWaitCondition cacheCond;
+    QMutex deviceMutex;
+    std::thread filler;
+    bool stopFilling = false;
 };
 
 QAVIODevice::QAVIODevice(QIODevice &device, QObject *parent)
     : QObject(parent)
-    , d_ptr(new QAVIODevicePrivate(this, device))
+    , d_ptr(new QAVIODevicePrivate(this, &device))
 {
     connect(&device, &QIODevice::readyRead, this, [this] {
         Q_D(QAVIODevice);
-        d->readData();
+        if (d->directRead)
+            d->wakeDirectRead();
+        else if (d->isReadAhead())
+            d->fillOnOwner();
+        else
+            d->readData();
     });
 }
 
+QAVIODevice::QAVIODevice(const uchar *data, qint64 size, QObject *parent)
+    : QObject(parent)
+    , d_ptr(new QAVIODevicePrivate(this, nullptr))
+{
+    Q_D(QAVIODevice);
+    d->memoryData = data;
+    d->memorySize = data ? qMax<qint64>(size, 0) : 0;
+}
+
 QAVIODevice::~QAVIODevice()
 {
     abort(true);
@@ -144,7 +513,60 @@ QAVIODevice::~QAVIODevice()
 
 AVIOContext *QAVIODevice::ctx() const
 {
-    return d_func()->ctx;
+    return const_cast<QAVIODevicePrivate *>(d_func())->context();
+}
+
+bool QAVIODevice::isDirectRead() const
+{
+    return d_func()->directRead;
+}
+
+void QAVIODevice::setDirectRead(bool direct)
+{
+    Q_D(QAVIODevice);
+    d->directRead = direct;
+}
+
+int QAVIODevice::bufferSize() const
+{
+    return d_func()->bufferSize;
+}
+
+void QAVIODevice::setBufferSize(int size)
+{
+    Q_D(QAVIODevice);
+    if (d->ctx) {
+        qWarning() << "Buffer size could not be changed after the context is created";
+        return;
+    }
+    d->bufferSize = size > 0 ? size : 64 * 1024;
+}
+
+qint64 QAVIODevice::readAheadBytes() const
+{
+    return d_func()->readAheadBytes;
+}
+
+qint64 QAVIODevice::readAheadDuration() const
+{
+    return d_func()->readAheadDuration;
+}
+
+void QAVIODevice::setReadAhead(qint64 bytes, qint64 ms)
+{
+    Q_D(QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    d->readAheadBytes = qMax<qint64>(bytes, 0);
+    d->readAheadDuration = qMax<qint64>(ms, 0);
+    d->cacheCond.wakeAll();
+}
+
+void QAVIODevice::setBitRate(qint64 bitRate)
+{
+    Q_D(QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    d->bitRate = bitRate;
+    d->cacheCond.wakeAll();
 }
 
 void QAVIODevice::abort(bool aborted)
@@ -153,6 +575,7 @@ void QAVIODevice::abort(bool aborted)
     QMutexLocker locker(&d->mutex);
     d->aborted = aborted;
     d->waitCond.wakeAll();
+    d->cacheCond.wakeAll();
 }
 
 QT_END_NAMESPACE
@@ -31,11 +31,32 @@ class Q_AVPLAYER_EXPORT QAVIODevice : public QObject
 {
 public:
     QAVIODevice(QIODevice &device, QObject *parent = nullptr);
+    // Reads directly from the memory, which must be valid until the object is destroyed
+    QAVIODevice(const uchar *data, qint64 size, QObject *parent = nullptr);
     ~QAVIODevice();
 
     AVIOContext *ctx() const;
     void abort(bool aborted);
 
+    // Reads the device on the demuxer thread instead of the thread it belongs to,
+    // the device must not be used by other threads while reading.
+    // Sequential devices are waited for by readyRead, delivered on their own thread
+    bool isDirectRead() const;
+    void setDirectRead(bool direct);
+
+    // Size of AVIO buffer, should be set before the context is created
+    int bufferSize() const;
+    void setBufferSize(int size);
+
+    // Reads ahead in background up to the limits, 0 leaves a limit unset,
+    // both 0 disable reading ahead.
+    // Duration is converted to bytes using the bit rate of the input.
+    // Without direct reads the cache is filled up to the limit on the thread of the device
+    qint64 readAheadBytes() const;
+    qint64 readAheadDuration() const;
+    void setReadAhead(qint64 bytes, qint64 ms = 0);
+    void setBitRate(qint64 bitRate);
+
 protected:
     std::unique_ptr<QAVIODevicePrivate> d_ptr;
 
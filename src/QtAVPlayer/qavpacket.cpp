@@ -7,6 +7,7 @@
 
 #include "qavpacket_p.h"
 #include "qavcodec_p.h"
+#include "qavframepool_p.h"
 #include "qavstream.h"
 #include <QSharedPointer>
 #include <QDebug>
@@ -19,52 +20,94 @@ extern "C" {
 
 QT_BEGIN_NAMESPACE
 
-class QAVPacketPrivate
+class QAVPacketPrivate : public QSharedData
 {
 public:
+    QAVPacketPrivate()
+        : pkt(QAVFramePool::allocPacket())
+    {
+        pkt->size = 0;
+        pkt->stream_index = -1;
+        pkt->pts = AV_NOPTS_VALUE;
+    }
+
+    QAVPacketPrivate(const QAVPacketPrivate &other)
+        : QSharedData(other)
+        , pkt(QAVFramePool::allocPacket())
+        , stream(other.stream)
+    {
+        av_packet_ref(pkt, other.pkt);
+    }
+
+    ~QAVPacketPrivate()
+    {
+        QAVFramePool::freePacket(&pkt);
+    }
+
     AVPacket *pkt = nullptr;
     QAVStream stream;
 };
 
+// Shared by all moved-from packets, never destroyed
+static QAVPacketPrivate *emptyPacketPrivate()
+{
+    static QAVPacketPrivate *d = [] {
+        auto p = new QAVPacketPrivate;
+        p->ref.ref();
+        return p;
+    }();
+    return d;
+}
+
 QAVPacket::QAVPacket(QObject *parent)
-    : QObject(parent)
-    , d_ptr(new QAVPacketPrivate)
+    : d_ptr(new QAVPacketPrivate)
 {
-    d_ptr->pkt = av_packet_alloc();
-    d_ptr->pkt->size = 0;
-    d_ptr->pkt->stream_index = -1;
-    d_ptr->pkt->pts = AV_NOPTS_VALUE;
+    Q_UNUSED(parent);
 }
 
 QAVPacket::QAVPacket(const QAVPacket &other)
-    : QAVPacket()
+    : d_ptr(other.d_ptr)
 {
-    *this = other;
 }
 
-QAVPacket &QAVPacket::operator=(const QAVPacket &other)
+QAVPacket::QAVPacket(QAVPacket &&other) noexcept
 {
-    av_packet_unref(d_ptr->pkt);
-    av_packet_ref(d_ptr->pkt, other.d_ptr->pkt);
+    d_ptr.swap(other.d_ptr);
+    other.d_ptr = QExplicitlySharedDataPointer<QAVPacketPrivate>(emptyPacketPrivate());
+}
 
-    d_ptr->stream = other.d_ptr->stream;
+QAVPacket &QAVPacket::operator=(const QAVPacket &other)
+{
+    d_ptr = other.d_ptr;
+    return *this;
+}
 
+QAVPacket &QAVPacket::operator=(QAVPacket &&other) noexcept
+{
+    if (this != &other) {
+        d_ptr.swap(other.d_ptr);
+        other.d_ptr = QExplicitlySharedDataPointer<QAVPacketPrivate>(emptyPacketPrivate());
+    }
     return *this;
 }
 
 QAVPacket::operator bool() const
 {
     Q_D(const QAVPacket);
-    return d->pkt->size;
+    return d && d->pkt->size;
 }
 
 QAVPacket::~QAVPacket()
 {
-    Q_D(QAVPacket);
-    av_packet_free(&d->pkt);
 }
 
-AVPacket *QAVPacket::packet() const
+AVPacket *QAVPacket::packet()
+{
+    detach();
+    return d_func()->pkt;
+}
+
+const AVPacket *QAVPacket::packet() const
 {
     return d_func()->pkt;
 }
@@ -95,6 +138,7 @@ QAVStream QAVPacket::stream() const
 
 void QAVPacket::setStream(const QAVStream &stream)
 {
+    detach();
     Q_D(QAVPacket);
     d->stream = stream;
 }
@@ -105,4 +149,14 @@ int QAVPacket::send() const
     return d->stream ? d->stream.codec()->write(*this) : 0;
 }
 
+void QAVPacket::detach()
+{
+    d_ptr.detach();
+}
+
+bool QAVPacket::isDetached() const
+{
+    return d_ptr && d_ptr->ref.loadAcquire() == 1;
+}
+
 QT_END_NAMESPACE
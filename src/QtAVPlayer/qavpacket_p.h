@@ -22,22 +22,27 @@
 #include "qavframe.h"
 #include "qavstream.h"
 #include <QObject>
-#include <memory>
+#include <QExplicitlySharedDataPointer>
 
 QT_BEGIN_NAMESPACE
 
 struct AVPacket;
 class QAVPacketPrivate;
-class Q_AVPLAYER_EXPORT QAVPacket : public QObject
+// Implicitly shared like the frames
+class Q_AVPLAYER_EXPORT QAVPacket
 {
 public:
     QAVPacket(QObject *parent = nullptr);
     ~QAVPacket();
     QAVPacket(const QAVPacket &other);
+    QAVPacket(QAVPacket &&other) noexcept;
     QAVPacket &operator=(const QAVPacket &other);
+    QAVPacket &operator=(QAVPacket &&other) noexcept;
     operator bool() const;
 
-    AVPacket *packet() const;
+    // Detaches from other copies, use the const overload to only read the packet
+    AVPacket *packet();
+    const AVPacket *packet() const;
     double duration() const;
     double pts() const;
 
@@ -47,13 +52,18 @@ public:
     // Sends the packet to the codec
     int send() const;
 
+    void detach();
+    bool isDetached() const;
+
 protected:
-    std::unique_ptr<QAVPacketPrivate> d_ptr;
+    QExplicitlySharedDataPointer<QAVPacketPrivate> d_ptr;
 
 private:
     Q_DECLARE_PRIVATE(QAVPacket)
 };
 
+Q_DECLARE_TYPEINFO(QAVPacket, Q_MOVABLE_TYPE);
+
 QT_END_NAMESPACE
 
 #endif
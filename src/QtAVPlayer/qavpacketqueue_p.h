@@ -26,11 +26,17 @@
 #include "qavsubtitleframe.h"
 #include "qavstreamframe.h"
 #include "qavdemuxer_p.h"
+#include "qavcodec_p.h"
+#include "qavtrace_p.h"
 #include <QMutex>
+#include <climits>
 #include <QWaitCondition>
+#include <QElapsedTimer>
 #include <QList>
 #include <math.h>
+#include <atomic>
 #include <memory>
+#include <vector>
 
 extern "C" {
 #include <libavutil/time.h>
@@ -49,6 +55,7 @@ public:
 
     bool wait(bool shouldSync, double pts, double speed = 1.0, double master = -1)
     {
+        QAV_TRACE("QAVQueueClock::wait");
         QMutexLocker locker(&m_mutex);
         double delay = pts - prevPts;
         if (isnan(delay) || delay <= 0 || delay > maxFrameDuration)
@@ -78,6 +85,8 @@ public:
             }
         }
 
+        // Positive if the frame is shown after its time
+        lastLateness = shouldSync ? time - (frameTimer + delay) : 0;
         prevPts = pts;
         frameTimer += delay;
         if ((delay > 0 && time - frameTimer > maxThreshold) || !shouldSync)
@@ -86,10 +95,16 @@ public:
         return true;
     }
 
+    // Does not lock, used by statistics while the clock waits
     double pts() const
     {
-        QMutexLocker locker(&m_mutex);
-        return prevPts;
+        return prevPts.load(std::memory_order_relaxed);
+    }
+
+    // In seconds
+    double lateness() const
+    {
+        return lastLateness.load(std::memory_order_relaxed);
     }
 
     void clear()
@@ -97,6 +112,7 @@ public:
         QMutexLocker locker(&m_mutex);
         prevPts = 0;
         frameTimer = 0;
+        lastLateness = 0;
     }
 
     void setFrameRate(double v)
@@ -108,7 +124,9 @@ public:
 private:
     double frameRate = 0;
     double frameTimer = 0;
-    double prevPts = 0;
+    // Written under the mutex
+    std::atomic<double> prevPts { 0 };
+    std::atomic<double> lastLateness { 0 };
     mutable QMutex m_mutex;
     const double maxFrameDuration = 10.0;
     const double minThreshold = 0.04;
@@ -117,13 +135,58 @@ private:
     const double refreshRate = 0.01;
 };
 
+// Blocks the producer until a consumer frees some space or a new request comes
+class QAVQueueWaiter
+{
+public:
+    void wait(unsigned long time = ULONG_MAX)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_woken)
+            m_cond.wait(&m_mutex, time);
+        m_woken = false;
+    }
+
+    void wake()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_woken = true;
+        m_cond.wakeAll();
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    bool m_woken = false;
+};
+
+inline qint64 frameBytes(const QAVFrame &frame)
+{
+    qint64 bytes = 0;
+    for (auto buf : frame.frame()->buf) {
+        if (buf)
+            bytes += buf->size;
+    }
+    return bytes;
+}
+
+inline qint64 frameBytes(const QAVSubtitleFrame &)
+{
+    return 0;
+}
+
+// Single producer/single consumer queue of packets.
+// The producer never takes the lock unless the ring is full,
+// the consumer serializes only with clearing the queue.
 template<class T>
 class QAVPacketQueue
 {
 public:
-    QAVPacketQueue(AVMediaType mediaType, QAVDemuxer &demuxer)
+    QAVPacketQueue(AVMediaType mediaType, QAVDemuxer &demuxer, QAVQueueWaiter *producer = nullptr)
         : m_mediaType(mediaType)
         , m_demuxer(demuxer)
+        , m_producer(producer)
+        , m_ring(ringSize)
     {
     }
 
@@ -138,46 +201,133 @@ public:
     }
 
     bool isEmpty() const
+    {
+        return m_count.load() == 0 && m_framesCount.load() == 0 && !m_decoding.load();
+    }
+
+    // Frames are decoded ahead by decode() up to the limits, 0 frames disables
+    void setDecodeAhead(int frames, qint64 bytes)
     {
         QMutexLocker locker(&m_mutex);
-        return m_packets.isEmpty() && m_decodedFrames.isEmpty();
+        m_maxFrames = frames;
+        m_maxFramesBytes = bytes;
+        m_spaceWaiter.wakeAll();
     }
 
-    void enqueue(const QAVPacket &packet)
+    bool isDecodeAhead() const
     {
         QMutexLocker locker(&m_mutex);
-        m_packets.append(packet);
-        m_bytes += packet.packet()->size + sizeof(packet);
-        m_duration += packet.duration();
-        m_consumerWaiter.wakeAll();
+        return m_maxFrames > 0;
+    }
+
+    // Decodes next packet to the frames queue,
+    // should be called from a separate thread if decode ahead is enabled
+    void decode()
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_abort && m_maxFrames > 0 && isFull())
+            m_spaceWaiter.wait(&m_mutex);
+        if (m_abort)
+            return;
+
+        auto packet = dequeue(true);
+        if (!packet.stream())
+            return;
+
+        const int generation = m_generation;
+        locker.unlock();
+        QList<T> frames;
+        decodePacket(packet, frames);
+        locker.relock();
+        // Drop the frames if the queue has been cleared meanwhile
+        if (generation == m_generation) {
+            for (const auto &frame : frames)
+                m_framesBytes += frameBytes(frame);
+            m_decodedFrames.append(std::move(frames));
+            m_framesCount = m_decodedFrames.size();
+            m_framesWaiter.wakeAll();
+        }
+        m_decoding = false;
+    }
+
+    // Called only by the producer
+    void enqueue(const QAVPacket &packet)
+    {
+        // Counted before the packet is published, so the consumer never sees it uncounted
+        m_bytes += packetBytes(packet);
+        m_duration += packetDuration(packet);
+        ++m_count;
+
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (m_overflowCount.load() > 0 || tail - m_head.load(std::memory_order_acquire) >= ringSize) {
+            QMutexLocker locker(&m_mutex);
+            m_overflow.append(packet);
+            ++m_overflowCount;
+        } else {
+            m_ring[tail & (ringSize - 1)] = packet;
+            m_tail.store(tail + 1, std::memory_order_release);
+        }
+
         m_abort = false;
-        m_waitingForPackets = false;
+        if (m_waitingForPackets.exchange(false)) {
+            QMutexLocker locker(&m_mutex);
+            m_consumerWaiter.wakeAll();
+        }
     }
 
-    bool frontFrame(T &frame)
+    // Moves the front frame out, it is still counted until popFrame() or restoreFrame()
+    bool takeFrame(T &frame)
     {
         QMutexLocker locker(&m_mutex);
-        if (m_decodedFrames.isEmpty())
-            m_demuxer.decode(dequeue(), m_decodedFrames);
-        if (m_decodedFrames.isEmpty())
+        if (m_maxFrames > 0) {
+            if (m_decodedFrames.isEmpty() && !m_abort && !m_wake)
+                m_framesWaiter.wait(&m_mutex);
+        } else if (m_decodedFrames.isEmpty()) {
+            decodePacket(dequeue(), m_decodedFrames);
+            m_framesCount = m_decodedFrames.size();
+            for (const auto &frame : m_decodedFrames)
+                m_framesBytes += frameBytes(frame);
+            m_decoding = false;
+        }
+        if (m_decodedFrames.isEmpty() || m_frontTaken)
             return false;
-        frame = m_decodedFrames.front();
+        m_framesBytes -= frameBytes(m_decodedFrames.front());
+        frame = std::move(m_decodedFrames.front());
+        m_frontTaken = true;
         return true;
     }
 
+    // Puts the taken frame back to be taken again
+    void restoreFrame(T &&frame)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_frontTaken)
+            return;
+        m_framesBytes += frameBytes(frame);
+        m_decodedFrames.front() = std::move(frame);
+        m_frontTaken = false;
+    }
+
+    // Removes the taken frame
     void popFrame()
     {
         QMutexLocker locker(&m_mutex);
-        if (!m_decodedFrames.isEmpty())
-            m_decodedFrames.pop_front();
+        if (m_frontTaken && !m_decodedFrames.isEmpty())
+            m_decodedFrames.removeFirst();
+        m_frontTaken = false;
+        m_framesCount = m_decodedFrames.size();
+        m_spaceWaiter.wakeAll();
+        wakeProducer();
     }
 
-    void waitForEmpty()
+    // Clears the queue without waiting for the consumer,
+    // the codec is flushed by the consumer before decoding next packet
+    void flush()
     {
         QMutexLocker locker(&m_mutex);
         clearPackets();
-        if (!m_abort && !m_waitingForPackets)
-            m_producerWaiter.wait(&m_mutex);
+        m_flushCodec = true;
+        wakeProducer();
     }
 
     void abort()
@@ -186,84 +336,222 @@ public:
         m_abort = true;
         m_waitingForPackets = true;
         m_consumerWaiter.wakeAll();
-        m_producerWaiter.wakeAll();
+        m_framesWaiter.wakeAll();
+        m_spaceWaiter.wakeAll();
     }
 
     bool enough() const
     {
-        QMutexLocker locker(&m_mutex);
         const int minFrames = 15;
-        return m_packets.size() > minFrames && (!m_duration || m_duration > 1.0);
+        const qint64 duration = m_duration.load(std::memory_order_relaxed);
+        return m_count.load(std::memory_order_relaxed) > minFrames && (!duration || duration > 1000);
     }
 
     int bytes() const
     {
-        QMutexLocker locker(&m_mutex);
-        return m_bytes;
+        return int(m_bytes.load(std::memory_order_relaxed));
+    }
+
+    int count() const
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    int framesCount() const
+    {
+        return m_framesCount.load(std::memory_order_relaxed);
+    }
+
+    qint64 framesBytes() const
+    {
+        return m_framesBytes.load(std::memory_order_relaxed);
+    }
+
+    // Total time spent in decoding in nanoseconds and the number of decoded frames
+    qint64 decodeTime() const
+    {
+        return m_decodeTime.load(std::memory_order_relaxed);
+    }
+
+    qint64 decodedFrames() const
+    {
+        return m_decodedCount.load(std::memory_order_relaxed);
+    }
+
+    void resetStatistics()
+    {
+        m_decodeTime = 0;
+        m_decodedCount = 0;
     }
 
     void clear()
     {
         QMutexLocker locker(&m_mutex);
         clearPackets();
+        wakeProducer();
     }
 
     void clearFrames()
     {
         QMutexLocker locker(&m_mutex);
-        m_decodedFrames.clear();
+        clearDecodedFrames();
+        wakeProducer();
     }
 
     void wake(bool wake)
     {
         QMutexLocker locker(&m_mutex);
-        if (wake)
+        if (wake) {
             m_consumerWaiter.wakeAll();
+            m_framesWaiter.wakeAll();
+        }
         m_wake = wake;
     }
 
 private:
-    QAVPacket dequeue()
+    static qint64 packetBytes(const QAVPacket &packet)
+    {
+        return packet.packet()->size + sizeof(packet);
+    }
+
+    // In milliseconds
+    static qint64 packetDuration(const QAVPacket &packet)
+    {
+        return qint64(packet.duration() * 1000);
+    }
+
+    void decodePacket(const QAVPacket &packet, QList<T> &frames)
     {
-        if (m_packets.isEmpty()) {
-            m_producerWaiter.wakeAll();
-            if (!m_abort && !m_wake) {
+        if (!packet.stream())
+            return;
+        QElapsedTimer timer;
+        timer.start();
+        const int size = frames.size();
+        m_demuxer.decode(packet, frames);
+        m_decodeTime.fetch_add(timer.nsecsElapsed(), std::memory_order_relaxed);
+        m_decodedCount.fetch_add(frames.size() - size, std::memory_order_relaxed);
+    }
+
+    bool isFull() const
+    {
+        return m_decodedFrames.size() >= m_maxFrames
+            || (m_maxFramesBytes > 0 && m_framesBytes >= m_maxFramesBytes);
+    }
+
+    // Called by the consumer under the lock
+    QAVPacket dequeue(bool ignoreWake = false)
+    {
+        if (m_count.load() == 0) {
+            wakeProducer();
+            if (!m_abort && (ignoreWake || !m_wake)) {
                 m_waitingForPackets = true;
-                m_consumerWaiter.wait(&m_mutex);
+                // The producer checks the flag after publishing a packet
+                if (m_count.load() == 0)
+                    m_consumerWaiter.wait(&m_mutex);
                 m_waitingForPackets = false;
             }
         }
-        if (m_packets.isEmpty())
+
+        // The packet is not counted anymore, but its frames are not counted yet
+        m_decoding = true;
+        auto packet = takePacket();
+        if (!packet.stream()) {
+            m_decoding = false;
+            return packet;
+        }
+        if (m_flushCodec) {
+            auto codec = packet.stream().codec();
+            if (codec)
+                codec->flushBuffers();
+            m_flushCodec = false;
+        }
+        return packet;
+    }
+
+    QAVPacket takePacket()
+    {
+        QAVPacket packet;
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head != m_tail.load(std::memory_order_acquire)) {
+            // Swaps with the empty packet, the slot does not keep the data
+            packet = std::move(m_ring[head & (ringSize - 1)]);
+            m_head.store(head + 1, std::memory_order_release);
+        } else if (!m_overflow.isEmpty()) {
+            packet = m_overflow.takeFirst();
+            --m_overflowCount;
+        } else {
             return {};
+        }
 
-        auto packet = m_packets.takeFirst();
-        m_bytes -= packet.packet()->size + sizeof(packet);
-        m_duration -= packet.duration();
+        m_bytes -= packetBytes(packet);
+        m_duration -= packetDuration(packet);
+        --m_count;
+        wakeProducer();
         return packet;
     }
 
+    void wakeProducer()
+    {
+        if (m_producer)
+            m_producer->wake();
+    }
+
     void clearPackets()
     {
-        m_packets.clear();
+        while (m_head.load(std::memory_order_relaxed) != m_tail.load(std::memory_order_acquire)
+               || !m_overflow.isEmpty())
+        {
+            takePacket();
+        }
+        clearDecodedFrames();
+    }
+
+    void clearDecodedFrames()
+    {
         m_decodedFrames.clear();
-        m_bytes = 0;
-        m_duration = 0;
+        m_frontTaken = false;
+        m_framesCount = 0;
+        m_framesBytes = 0;
+        ++m_generation;
+        m_spaceWaiter.wakeAll();
     }
 
+    static constexpr size_t ringSize = 512;
+
     const AVMediaType m_mediaType = AVMEDIA_TYPE_UNKNOWN;
     QAVDemuxer &m_demuxer;
-    QList<QAVPacket> m_packets;
+    QAVQueueWaiter *m_producer = nullptr;
+
+    std::vector<QAVPacket> m_ring;
+    std::atomic<size_t> m_head { 0 };
+    std::atomic<size_t> m_tail { 0 };
+    // Used when the ring is full, guarded by the mutex
+    QList<QAVPacket> m_overflow;
+    std::atomic<int> m_overflowCount { 0 };
+    std::atomic<int> m_count { 0 };
+    std::atomic<qint64> m_bytes { 0 };
+    std::atomic<qint64> m_duration { 0 };
+
     // Tracks decoded frames to prevent EOF if not all frames are landed
     QList<T> m_decodedFrames;
+    std::atomic<int> m_framesCount { 0 };
+    std::atomic<qint64> m_framesBytes { 0 };
+    std::atomic<qint64> m_decodeTime { 0 };
+    std::atomic<qint64> m_decodedCount { 0 };
+    // The front frame has been moved out by takeFrame()
+    bool m_frontTaken = false;
+    std::atomic<bool> m_decoding { false };
+    int m_generation = 0;
+    int m_maxFrames = 0;
+    qint64 m_maxFramesBytes = 0;
+    QWaitCondition m_framesWaiter;
+    QWaitCondition m_spaceWaiter;
     mutable QMutex m_mutex;
     QWaitCondition m_consumerWaiter;
-    QWaitCondition m_producerWaiter;
-    bool m_abort = false;
-    bool m_waitingForPackets = true;
+    std::atomic<bool> m_abort { false };
+    std::atomic<bool> m_waitingForPackets { true };
     bool m_wake = false;
-
-    int m_bytes = 0;
-    int m_duration = 0;
+    bool m_flushCodec = false;
 
 private:
     Q_DISABLE_COPY(QAVPacketQueue)
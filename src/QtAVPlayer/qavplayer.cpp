@@ -18,9 +18,17 @@
 #include "qavvideofilter_p.h"
 #include "qavaudiofilter_p.h"
 #include "qavfilters_p.h"
+#include "qavtrace_p.h"
 #include <QtConcurrent/qtconcurrentrun.h>
 #include <QLoggingCategory>
+#include <QFile>
+#include <QFileInfo>
+#include <QUrl>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <functional>
+#include <atomic>
+#include <memory>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -41,23 +49,49 @@ enum PendingMediaStatus
     EndOfMedia
 };
 
+// Counts emitted frames until the consumers release them
+struct QAVFrameBudget
+{
+    QMutex mutex;
+    QWaitCondition cond;
+    int inFlight = 0;
+    int max = 0;
+
+    void release()
+    {
+        {
+            QMutexLocker locker(&mutex);
+            --inFlight;
+        }
+        cond.wakeAll();
+    }
+
+    void wake()
+    {
+        QMutexLocker locker(&mutex);
+        cond.wakeAll();
+    }
+};
+
 class QAVPlayerPrivate
 {
     Q_DECLARE_PUBLIC(QAVPlayer)
 public:
     QAVPlayerPrivate(QAVPlayer *q)
         : q_ptr(q)
-        , videoQueue(AVMEDIA_TYPE_VIDEO, demuxer)
-        , audioQueue(AVMEDIA_TYPE_AUDIO, demuxer)
-        , subtitleQueue(AVMEDIA_TYPE_SUBTITLE, demuxer)
+        , videoQueue(AVMEDIA_TYPE_VIDEO, demuxer, &demuxerWaiter)
+        , audioQueue(AVMEDIA_TYPE_AUDIO, demuxer, &demuxerWaiter)
+        , subtitleQueue(AVMEDIA_TYPE_SUBTITLE, demuxer, &demuxerWaiter)
     {
-        threadPool.setMaxThreadCount(4);
+        threadPool.setMaxThreadCount(6);
+        elapsed.start();
     }
 
     QAVPlayer::Error currentError() const;
     void setMediaStatus(QAVPlayer::MediaStatus status);
     void resetPendingStatuses();
     void setPendingMediaStatus(PendingMediaStatus status);
+    void coalescePendingMediaStatus(PendingMediaStatus status);
     void step(bool hasFrame);
     bool doStep(PendingMediaStatus status, bool hasFrame);
     bool setState(QAVPlayer::State s);
@@ -74,6 +108,8 @@ public:
     void applyFilters(bool reset, const QAVFrame &frame);
 
     void terminate();
+    void open(const QString &source);
+    bool mapFile(const QString &source);
 
     void doWait();
     void wait(bool v);
@@ -104,6 +140,11 @@ public:
     void doPlayVideo();
     void doPlayAudio();
     void doPlaySubtitle();
+    void doDecodeVideo();
+    void doDecodeAudio();
+    bool dropLateFrame(const QAVFrame &frame, double refPts);
+    bool acquireFrame(const QAVStreamFrame &frame);
+    void setSkipLevel(int level);
 
     template <class T>
     void dispatch(T fn);
@@ -125,12 +166,18 @@ public:
     double pendingPosition = 0;
     bool pendingSeek = false;
     double currPts = 0.0;
+    // Seeks only to keyframes while scrubbing
+    bool scrubbing = false;
+    bool keyframeSeek = false;
+    qint64 scrubPosition = -1;
     mutable QMutex positionMutex;
     bool synced = true;
 
     QAVPlayer::Error error = QAVPlayer::NoError;
 
     QAVDemuxer demuxer;
+    // Wakes up the demuxer when packets are consumed, seek requested or quit
+    QAVQueueWaiter demuxerWaiter;
 
     QThreadPool threadPool;
     QFuture<void> loaderFuture;
@@ -145,6 +192,26 @@ public:
     QAVQueueClock audioClock;
 
     QFuture<void> subtitlePlayFuture;
+
+    // Decodes frames ahead if enabled
+    QFuture<void> videoDecodeFuture;
+    QFuture<void> audioDecodeFuture;
+    int decodeAheadFrames = 0;
+    qint64 decodeAheadBytes = 0;
+
+    bool directIO = false;
+    bool fileMapping = false;
+    QScopedPointer<QFile> mappedFile;
+    int ioBufferSize = 0;
+    qint64 readAheadBytes = 0;
+    qint64 readAheadDuration = 0;
+
+    // Late video frames are dropped and decoder skips frames under sustained lag
+    std::atomic<bool> frameDropping { false };
+    std::atomic<qint64> droppedFrames { 0 };
+    int skipLevel = 0;
+    int lateFrames = 0;
+    int onTimeFrames = 0;
     QAVPacketQueue<QAVSubtitleFrame> subtitleQueue;
     QAVQueueClock subtitleClock;
 
@@ -156,6 +223,19 @@ public:
 
     QList<QString> filterDescs;
     QAVFilters filters;
+
+    // Statistics are collected by atomics only
+    QElapsedTimer elapsed;
+    std::atomic<qint64> filterTime { 0 };
+    std::atomic<qint64> filterCount { 0 };
+    std::atomic<qint64> readBytes { 0 };
+    std::atomic<qint64> readTime { 0 };
+    std::atomic<qint64> seekStarted { 0 };
+    std::atomic<qint64> seekLatency { 0 };
+    QTimer statisticsTimer;
+
+    // Shared with the emitted frames, which can outlive the player
+    std::shared_ptr<QAVFrameBudget> frameBudget = std::make_shared<QAVFrameBudget>();
 };
 
 static QString err_str(int err)
@@ -206,6 +286,15 @@ void QAVPlayerPrivate::setPendingMediaStatus(PendingMediaStatus status)
     qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << mediaStatus << "->" << pendingMediaStatuses;
 }
 
+void QAVPlayerPrivate::coalescePendingMediaStatus(PendingMediaStatus status)
+{
+    QMutexLocker locker(&stateMutex);
+    if (!pendingMediaStatuses.isEmpty() && pendingMediaStatuses.last() == status)
+        return;
+    pendingMediaStatuses.push_back(status);
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << mediaStatus << "->" << pendingMediaStatuses;
+}
+
 bool QAVPlayerPrivate::setState(QAVPlayer::State s)
 {
     Q_Q(QAVPlayer);
@@ -314,6 +403,8 @@ void QAVPlayerPrivate::terminate()
     setState(QAVPlayer::StoppedState);
     quit = true;
     wait(false);
+    frameBudget->wake();
+    demuxerWaiter.wake();
     videoFrameRate = 0.0;
     videoQueue.clear();
     videoQueue.abort();
@@ -330,14 +421,31 @@ void QAVPlayerPrivate::terminate()
     demuxerFuture.waitForFinished();
     videoPlayFuture.waitForFinished();
     audioPlayFuture.waitForFinished();
+    videoDecodeFuture.waitForFinished();
+    audioDecodeFuture.waitForFinished();
+    droppedFrames = 0;
+    filterTime = 0;
+    filterCount = 0;
+    readBytes = 0;
+    readTime = 0;
+    seekLatency = 0;
+    videoQueue.resetStatistics();
+    audioQueue.resetStatistics();
+    subtitleQueue.resetStatistics();
+    skipLevel = 0;
+    lateFrames = 0;
+    onTimeFrames = 0;
     pendingPosition = 0;
     pendingSeek = false;
+    keyframeSeek = false;
+    scrubPosition = -1;
     currPts = 0.0;
     pendingMediaStatuses.clear();
     filters.clear();
     setDuration(0);
     error = QAVPlayer::NoError;
     dev.reset();
+    mappedFile.reset();
     eof = false;
 }
 
@@ -394,6 +502,8 @@ bool QAVPlayerPrivate::doStep(PendingMediaStatus status, bool hasFrame)
                 if (q_ptr->mediaStatus() == QAVPlayer::EndOfMedia)
                     setMediaStatus(QAVPlayer::LoadedMedia);
                 qCDebug(lcAVPlayer) << "Seeked to pos:" << q_ptr->position();
+                // Rounded up, 0 means no seek has finished yet
+                seekLatency = (elapsed.nsecsElapsed() - seekStarted + 999999) / 1000000;
                 emit q_ptr->seeked(q_ptr->position());
                 QAVPlayer::State currState = q_ptr->state();
                 if (currState == QAVPlayer::PausedState || currState == QAVPlayer::StoppedState)
@@ -471,6 +581,7 @@ void QAVPlayerPrivate::wait(bool v)
     videoQueue.wake(true);
     audioQueue.wake(true);
     subtitleQueue.wake(true);
+    demuxerWaiter.wake();
 }
 
 void QAVPlayerPrivate::applyFilters()
@@ -494,8 +605,52 @@ void QAVPlayerPrivate::applyFilters(bool reset, const QAVFrame &frame)
         setMediaStatus(QAVPlayer::LoadedMedia);
 }
 
+void QAVPlayerPrivate::open(const QString &source)
+{
+    Q_Q(QAVPlayer);
+    url = source;
+    emit q->sourceChanged(url);
+    wait(true);
+    quit = false;
+    if (url.isEmpty())
+        return;
+
+    setPendingMediaStatus(LoadingMedia);
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    loaderFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doLoad);
+#else
+    loaderFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doLoad, this);
+#endif
+}
+
+bool QAVPlayerPrivate::mapFile(const QString &source)
+{
+    QFileInfo info(source.startsWith(QLatin1String("file:")) ? QUrl(source).toLocalFile() : source);
+    if (!info.isFile())
+        return false;
+
+    QScopedPointer<QFile> file(new QFile(info.absoluteFilePath()));
+    if (!file->open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = file->size();
+    uchar *data = size > 0 ? file->map(0, size) : nullptr;
+    if (!data) {
+        qCDebug(lcAVPlayer) << "Could not map:" << info.absoluteFilePath() << file->errorString();
+        return false;
+    }
+
+    mappedFile.reset(file.take());
+    dev.reset(new QAVIODevice(data, size));
+    if (ioBufferSize > 0)
+        dev->setBufferSize(ioBufferSize);
+    return true;
+}
+
 void QAVPlayerPrivate::doLoad()
 {
+    QAVTraceThreadName traceName("loader");
     demuxer.abort(false);
     demuxer.unload();
     int ret = demuxer.load(url, dev.data());
@@ -518,6 +673,10 @@ void QAVPlayerPrivate::doLoad()
         step(false);
     });
 
+    videoQueue.setDecodeAhead(decodeAheadFrames, decodeAheadBytes);
+    audioQueue.setDecodeAhead(decodeAheadFrames, decodeAheadBytes);
+    const bool decodeAhead = decodeAheadFrames > 0;
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     demuxerFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doDemux);
     if (!q_ptr->availableVideoStreams().isEmpty())
@@ -526,6 +685,10 @@ void QAVPlayerPrivate::doLoad()
         audioPlayFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doPlayAudio);
     if (!q_ptr->availableSubtitleStreams().isEmpty())
         subtitlePlayFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doPlaySubtitle);
+    if (decodeAhead && !q_ptr->availableVideoStreams().isEmpty())
+        videoDecodeFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doDecodeVideo);
+    if (decodeAhead && !q_ptr->availableAudioStreams().isEmpty())
+        audioDecodeFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doDecodeAudio);
 #else
     demuxerFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doDemux, this);
     if (!q_ptr->availableVideoStreams().isEmpty())
@@ -534,22 +697,31 @@ void QAVPlayerPrivate::doLoad()
         audioPlayFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doPlayAudio, this);
     if (!q_ptr->availableSubtitleStreams().isEmpty())
         subtitlePlayFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doPlaySubtitle, this);
+    if (decodeAhead && !q_ptr->availableVideoStreams().isEmpty())
+        videoDecodeFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doDecodeVideo, this);
+    if (decodeAhead && !q_ptr->availableAudioStreams().isEmpty())
+        audioDecodeFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doDecodeAudio, this);
 #endif
     qCDebug(lcAVPlayer) << __FUNCTION__ << "finished";
 }
 
 void QAVPlayerPrivate::doDemux()
 {
+    QAVTraceThreadName traceName("demuxer");
     const int maxQueueBytes = 15 * 1024 * 1024;
-    QMutex waiterMutex;
-    QWaitCondition waiter;
 
     while (!quit) {
-        if (videoQueue.bytes() + audioQueue.bytes() > maxQueueBytes
-            || (videoQueue.enough() && audioQueue.enough()))
+        bool seeking = false;
         {
-            QMutexLocker locker(&waiterMutex);
-            waiter.wait(&waiterMutex, 10);
+            QMutexLocker locker(&positionMutex);
+            seeking = pendingSeek;
+        }
+
+        if (!seeking
+            && (videoQueue.bytes() + audioQueue.bytes() > maxQueueBytes
+                || (videoQueue.enough() && audioQueue.enough())))
+        {
+            demuxerWaiter.wait();
             continue;
         }
 
@@ -561,35 +733,43 @@ void QAVPlayerPrivate::doDemux()
                 if (pendingPosition < 0)
                     pendingPosition = 0;
                 const double pos = pendingPosition;
+                const bool keyframeOnly = keyframeSeek;
                 locker.unlock();
                 qCDebug(lcAVPlayer) << "Seeking to pos:" << pos * 1000;
                 int ret = demuxer.seek(pos);
                 if (ret >= 0) {
-                    qCDebug(lcAVPlayer) << "Waiting video thread finished processing packets";
-                    videoQueue.waitForEmpty();
+                    // Codecs are flushed by the decoding threads before next packet
+                    qCDebug(lcAVPlayer) << "Flush queues";
+                    videoQueue.flush();
                     videoClock.clear();
-                    qCDebug(lcAVPlayer) << "Waiting audio thread finished processing packets";
-                    audioQueue.waitForEmpty();
+                    audioQueue.flush();
                     audioClock.clear();
-                    qCDebug(lcAVPlayer) << "Waiting subtitle thread finished processing packets";
-                    subtitleQueue.waitForEmpty();
+                    subtitleQueue.flush();
                     subtitleClock.clear();
-                    qCDebug(lcAVPlayer) << "Flush codec buffers";
-                    demuxer.flushCodecBuffers();
-                    qCDebug(lcAVPlayer) << "Reset filters";
-                    applyFilters(true, {});
+                    // Filters are recreated only if changed
+                    filters.discard();
+                    applyFilters(false, {});
                     qCDebug(lcAVPlayer) << "Start reading packets from" << pos * 1000;
                 } else {
                     qWarning() << "Could not seek:" << ret << ":" << err_str(ret);
                 }
                 locker.relock();
-                if (qFuzzyCompare(pendingPosition, pos))
+                // Newer seek requests are handled in next iteration
+                if (qFuzzyCompare(pendingPosition, pos)) {
                     pendingSeek = false;
+                    // Shows the keyframe without decoding up to the position
+                    if (keyframeOnly)
+                        pendingPosition = 0;
+                }
             }
         }
 
+        QElapsedTimer readTimer;
+        readTimer.start();
         auto packet = demuxer.read();
+        readTime += readTimer.nsecsElapsed();
         if (packet.stream()) {
+            readBytes += packet.packet()->size;
             endOfFile(false);
             // Empty packet points to EOF and it needs to flush codecs
             switch (demuxer.currentCodecType(packet.packet()->stream_index)) {
@@ -621,13 +801,31 @@ void QAVPlayerPrivate::doDemux()
                 wait(false);
             }
 
-            QMutexLocker locker(&waiterMutex);
-            waiter.wait(&waiterMutex, 10);
+            // Nothing will be read until seek, setSource() or the queues are drained if EOF.
+            // Otherwise no packet was ready yet, e.g. the bitstream filters need more input
+            if (demuxer.eof())
+                demuxerWaiter.wait();
         }
     }
     qCDebug(lcAVPlayer) << __FUNCTION__ << "finished";
 }
 
+void QAVPlayerPrivate::doDecodeVideo()
+{
+    QAVTraceThreadName traceName("video decoder");
+    while (!quit)
+        videoQueue.decode();
+    qCDebug(lcAVPlayer) << __FUNCTION__ << "finished";
+}
+
+void QAVPlayerPrivate::doDecodeAudio()
+{
+    QAVTraceThreadName traceName("audio decoder");
+    while (!quit)
+        audioQueue.decode();
+    qCDebug(lcAVPlayer) << __FUNCTION__ << "finished";
+}
+
 static double streamDuration(const QAVStreamFrame &frame, const QAVDemuxer &demuxer)
 {
     double duration = demuxer.duration();
@@ -695,24 +893,52 @@ void QAVPlayerPrivate::doPlayStep(
 
     // 1. Decode a frame
     QAVFrame decodedFrame;
-    queue.frontFrame(decodedFrame);
+    queue.takeFrame(decodedFrame);
     bool flushEvents = false;
     int ret = 0;
 
-    // 2. Filter decoded frame
+    // Frames before accurate seek position are only decoded, no filters or sync
+    if (decodedFrame && skipFrame(master, decodedFrame, queue.isEmpty())) {
+        queue.popFrame();
+        if (master)
+            step(false);
+        return;
+    }
+
+    // Late frames are dropped before spending time in the filters
+    if (decodedFrame && refPts > 0 && dropLateFrame(decodedFrame, refPts)) {
+        queue.popFrame();
+        if (master)
+            step(false);
+        return;
+    }
+
+    // 2. Filter decoded frame, it is moved to the filters or to the filtered frames
     QList<QAVFrame> filteredFrames;
-    if (decodedFrame)
-        ret = filters.write(queue.mediaType(), decodedFrame);
+    QElapsedTimer filterTimer;
+    filterTimer.start();
+    if (decodedFrame) {
+        ret = filters.write(queue.mediaType(), std::move(decodedFrame));
+        ++filterCount;
+    }
     if (ret >= 0 || ret == AVERROR(EAGAIN))
-        ret = filters.read(queue.mediaType(), decodedFrame, filteredFrames);
+        ret = filters.read(queue.mediaType(), std::move(decodedFrame), filteredFrames);
+    filterTime += filterTimer.nsecsElapsed();
     if (ret < 0 && ret != AVERROR(EAGAIN)) {
         // Try filters again
         filteredFrames.clear();
         if (ret != AVERROR(ENOTSUP)) {
+            // The frame might be already taken by the filters
+            if (decodedFrame)
+                queue.restoreFrame(std::move(decodedFrame));
+            else
+                queue.popFrame();
             setError(QAVPlayer::FilterError, err_str(ret));
             return;
         }
+        // Not supported frames are not taken by the filters
         applyFilters(true, decodedFrame);
+        queue.restoreFrame(std::move(decodedFrame));
     } else {
         // The frame is already filtered, decode next one
         queue.popFrame();
@@ -729,6 +955,8 @@ void QAVPlayerPrivate::doPlayStep(
                 refPts))
         {
             sync = !skipFrame(master, frame, queue.isEmpty());
+            if (sync && !acquireFrame(frame))
+                break;
             if (sync) {
                 if (master)
                     setPts(frame.pts());
@@ -746,8 +974,68 @@ void QAVPlayerPrivate::doPlayStep(
         step(flushEvents);
 }
 
+bool QAVPlayerPrivate::dropLateFrame(const QAVFrame &frame, double refPts)
+{
+    if (!frameDropping || !synced)
+        return false;
+
+    {
+        QMutexLocker locker(&stateMutex);
+        if (state != QAVPlayer::PlayingState || !pendingMediaStatuses.isEmpty())
+            return false;
+    }
+
+    const double dropThreshold = 0.1;
+    const int maxLateFrames = 5;
+    const int minOnTimeFrames = 50;
+    if (refPts - frame.pts() <= dropThreshold) {
+        lateFrames = 0;
+        if (skipLevel > 0 && ++onTimeFrames >= minOnTimeFrames)
+            setSkipLevel(skipLevel - 1);
+        return false;
+    }
+
+    onTimeFrames = 0;
+    ++droppedFrames;
+    if (++lateFrames >= maxLateFrames && skipLevel < 3)
+        setSkipLevel(skipLevel + 1);
+    return true;
+}
+
+// Waits until the consumers release enough frames if limited
+bool QAVPlayerPrivate::acquireFrame(const QAVStreamFrame &frame)
+{
+    auto budget = frameBudget;
+    {
+        QMutexLocker locker(&budget->mutex);
+        if (budget->max <= 0)
+            return true;
+        while (!quit && budget->max > 0 && budget->inFlight >= budget->max)
+            budget->cond.wait(&budget->mutex);
+        if (quit)
+            return false;
+        ++budget->inFlight;
+    }
+
+    frame.d_ptr->onRelease = std::shared_ptr<void>(nullptr, [budget](void *) { budget->release(); });
+    return true;
+}
+
+void QAVPlayerPrivate::setSkipLevel(int level)
+{
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << skipLevel << "->" << level;
+    skipLevel = level;
+    lateFrames = 0;
+    onTimeFrames = 0;
+    for (const auto &stream : demuxer.currentVideoStreams()) {
+        if (stream.codec())
+            static_cast<QAVVideoCodec *>(stream.codec().data())->setSkipLevel(level);
+    }
+}
+
 void QAVPlayerPrivate::doPlayVideo()
 {
+    QAVTraceThreadName traceName("video");
     videoClock.setFrameRate(demuxer.videoFrameRate());
     const bool master = true;
     bool sync = true;
@@ -759,7 +1047,10 @@ void QAVPlayerPrivate::doPlayVideo()
             videoClock,
             videoQueue,
             sync,
-            [&](const QAVFrame &frame) { emit q_ptr->videoFrame(frame); }
+            [&](const QAVFrame &frame) {
+                QAV_TRACE("QAVPlayer::videoFrame");
+                emit q_ptr->videoFrame(frame);
+            }
         );
     }
 
@@ -771,6 +1062,7 @@ void QAVPlayerPrivate::doPlayVideo()
 
 void QAVPlayerPrivate::doPlayAudio()
 {
+    QAVTraceThreadName traceName("audio");
     const bool master = demuxer.currentVideoStreams().isEmpty();
     const double ref = -1;
     bool sync = true;
@@ -783,8 +1075,16 @@ void QAVPlayerPrivate::doPlayAudio()
             audioQueue,
             sync,
             [this](const QAVFrame &frame) {
-                frame.frame()->sample_rate *= q_ptr->speed();
-                emit q_ptr->audioFrame(frame);
+                QAV_TRACE("QAVPlayer::audioFrame");
+                const double speed = q_ptr->speed();
+                if (speed == 1.0) {
+                    emit q_ptr->audioFrame(frame);
+                    return;
+                }
+                // Other copies keep the original sample rate
+                QAVFrame f = frame;
+                f.frame()->sample_rate *= speed;
+                emit q_ptr->audioFrame(f);
             }
         );
     }
@@ -806,7 +1106,7 @@ void QAVPlayerPrivate::doPlayStep(
 
     // 1. Decode a frame
     QAVSubtitleFrame decodedFrame;
-    if (!queue.frontFrame(decodedFrame))
+    if (!queue.takeFrame(decodedFrame))
         return;
 
     // 2. Sync decoded frame
@@ -818,22 +1118,28 @@ void QAVPlayerPrivate::doPlayStep(
     {
         sync = !skipFrame(false, decodedFrame, queue.isEmpty());
         if (sync) {
-            if (decodedFrame)
+            if (decodedFrame && acquireFrame(decodedFrame))
                 cb(decodedFrame);
         }
         queue.popFrame();
+    } else {
+        queue.restoreFrame(std::move(decodedFrame));
     }
 }
 
 void QAVPlayerPrivate::doPlaySubtitle()
 {
+    QAVTraceThreadName traceName("subtitle");
     bool sync = true;
     while (!quit) {
         doPlayStep(
             subtitleClock,
             subtitleQueue,
             sync,
-            [this](const QAVSubtitleFrame &frame) { emit q_ptr->subtitleFrame(frame); }
+            [this](const QAVSubtitleFrame &frame) {
+                QAV_TRACE("QAVPlayer::subtitleFrame");
+                emit q_ptr->subtitleFrame(frame);
+            }
         );
     }
 
@@ -852,13 +1158,24 @@ QAVPlayer::QAVPlayer(QObject *parent)
     qRegisterMetaType<State>();
     qRegisterMetaType<MediaStatus>();
     qRegisterMetaType<Error>();
+    qRegisterMetaType<DecodingThreadType>();
     qRegisterMetaType<QAVStream>();
+    qRegisterMetaType<Statistics>();
+    if (!QAVTrace::traceFile().isEmpty())
+        QAVTrace::setEnabled(true);
+
+    QObject::connect(&d_ptr->statisticsTimer, &QTimer::timeout, this, [this] {
+        emit statisticsUpdated(statistics());
+    });
 }
 
 QAVPlayer::~QAVPlayer()
 {
     Q_D(QAVPlayer);
     d->terminate();
+    const QString traceFile = QAVTrace::traceFile();
+    if (!traceFile.isEmpty())
+        QAVTrace::save(traceFile);
 }
 
 void QAVPlayer::setSource(const QString &url, QIODevice *dev)
@@ -870,22 +1187,34 @@ void QAVPlayer::setSource(const QString &url, QIODevice *dev)
     qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << url;
 
     d->terminate();
-    d->url = url;
-    if (dev)
+    if (dev) {
         d->dev.reset(new QAVIODevice(*dev));
-    emit sourceChanged(url);
-    d->wait(true);
-    d->quit = false;
-    if (url.isEmpty())
+        d->dev->setDirectRead(d->directIO);
+        if (d->ioBufferSize > 0)
+            d->dev->setBufferSize(d->ioBufferSize);
+        d->dev->setReadAhead(d->readAheadBytes, d->readAheadDuration);
+    } else if (d->fileMapping) {
+        d->mapFile(url);
+    }
+    d->open(url);
+}
+
+void QAVPlayer::setSource(const QString &url, const uchar *data, qint64 size)
+{
+    Q_D(QAVPlayer);
+    // The same url could point to other data
+    if (d->url == url && !data)
         return;
 
-    d->setPendingMediaStatus(LoadingMedia);
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << url << size;
 
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    d->loaderFuture = QtConcurrent::run(&d->threadPool, d, &QAVPlayerPrivate::doLoad);
-#else
-    d->loaderFuture = QtConcurrent::run(&d->threadPool, &QAVPlayerPrivate::doLoad, d);
-#endif
+    d->terminate();
+    if (data) {
+        d->dev.reset(new QAVIODevice(data, size));
+        if (d->ioBufferSize > 0)
+            d->dev->setBufferSize(d->ioBufferSize);
+    }
+    d->open(url);
 }
 
 QString QAVPlayer::source() const
@@ -1106,13 +1435,24 @@ void QAVPlayer::seek(qint64 pos)
         return;
 
     qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << "pos:" << pos;
+    d->seekStarted = d->elapsed.nsecsElapsed();
+    bool scrubbing = false;
     {
         QMutexLocker locker(&d->positionMutex);
         d->pendingSeek = true;
         d->pendingPosition = pos / 1000.0;
+        d->keyframeSeek = d->scrubbing;
+        if (d->scrubbing)
+            d->scrubPosition = pos;
+        scrubbing = d->scrubbing;
     }
+    d->demuxerWaiter.wake();
 
-    d->setPendingMediaStatus(SeekingMedia);
+    // A burst of seeks while scrubbing leads to one seek to the latest position
+    if (scrubbing)
+        d->coalescePendingMediaStatus(SeekingMedia);
+    else
+        d->setPendingMediaStatus(SeekingMedia);
     d->wait(false);
     if (mediaStatus() != QAVPlayer::NoMedia)
         d->applyFilters();
@@ -1298,6 +1638,354 @@ void QAVPlayer::setInputOptions(const QMap<QString, QString>  &opts)
     emit inputOptionsChanged(opts);
 }
 
+int QAVPlayer::decodingThreads() const
+{
+    Q_D(const QAVPlayer);
+    return d->demuxer.decodingThreads();
+}
+
+void QAVPlayer::setDecodingThreads(int threads)
+{
+    Q_D(QAVPlayer);
+    threads = qMax(threads, 0);
+    int current = decodingThreads();
+    if (threads == current)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << current << "->" << threads;
+    d->demuxer.setDecodingThreads(threads);
+    emit decodingThreadsChanged(threads);
+}
+
+QAVPlayer::DecodingThreadType QAVPlayer::decodingThreadType() const
+{
+    Q_D(const QAVPlayer);
+    return DecodingThreadType(d->demuxer.decodingThreadType());
+}
+
+void QAVPlayer::setDecodingThreadType(DecodingThreadType type)
+{
+    Q_D(QAVPlayer);
+    auto current = decodingThreadType();
+    if (type == current)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << current << "->" << type;
+    // Values match FF_THREAD_FRAME and FF_THREAD_SLICE
+    d->demuxer.setDecodingThreadType(int(type));
+    emit decodingThreadTypeChanged(type);
+}
+
+bool QAVPlayer::isScrubbing() const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->positionMutex);
+    return d->scrubbing;
+}
+
+void QAVPlayer::setScrubbing(bool scrubbing)
+{
+    Q_D(QAVPlayer);
+    qint64 pos = -1;
+    {
+        QMutexLocker locker(&d->positionMutex);
+        if (d->scrubbing == scrubbing)
+            return;
+
+        qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->scrubbing << "->" << scrubbing;
+        d->scrubbing = scrubbing;
+        pos = d->scrubPosition;
+        d->scrubPosition = -1;
+    }
+
+    emit scrubbingChanged(scrubbing);
+    // Precise seek to the last requested position
+    if (!scrubbing && pos >= 0)
+        seek(pos);
+}
+
+bool QAVPlayer::isFrameDropping() const
+{
+    Q_D(const QAVPlayer);
+    return d->frameDropping;
+}
+
+void QAVPlayer::setFrameDropping(bool drop)
+{
+    Q_D(QAVPlayer);
+    if (d->frameDropping == drop)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << !drop << "->" << drop;
+    d->frameDropping = drop;
+    emit frameDroppingChanged(drop);
+}
+
+qint64 QAVPlayer::droppedFrames() const
+{
+    Q_D(const QAVPlayer);
+    return d->droppedFrames;
+}
+
+qint64 QAVPlayer::skippedFrames() const
+{
+    Q_D(const QAVPlayer);
+    qint64 result = 0;
+    for (const auto &stream : d->demuxer.currentVideoStreams()) {
+        if (stream.codec())
+            result += static_cast<QAVVideoCodec *>(stream.codec().data())->skippedFrames();
+    }
+    return result;
+}
+
+int QAVPlayer::decodeAheadFrames() const
+{
+    Q_D(const QAVPlayer);
+    return d->decodeAheadFrames;
+}
+
+void QAVPlayer::setDecodeAheadFrames(int frames)
+{
+    Q_D(QAVPlayer);
+    frames = qMax(frames, 0);
+    if (d->decodeAheadFrames == frames)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->decodeAheadFrames << "->" << frames;
+    d->decodeAheadFrames = frames;
+    emit decodeAheadFramesChanged(frames);
+}
+
+qint64 QAVPlayer::decodeAheadBytes() const
+{
+    Q_D(const QAVPlayer);
+    return d->decodeAheadBytes;
+}
+
+void QAVPlayer::setDecodeAheadBytes(qint64 bytes)
+{
+    Q_D(QAVPlayer);
+    bytes = qMax<qint64>(bytes, 0);
+    if (d->decodeAheadBytes == bytes)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->decodeAheadBytes << "->" << bytes;
+    d->decodeAheadBytes = bytes;
+    emit decodeAheadBytesChanged(bytes);
+}
+
+bool QAVPlayer::isDirectIO() const
+{
+    Q_D(const QAVPlayer);
+    return d->directIO;
+}
+
+void QAVPlayer::setDirectIO(bool direct)
+{
+    Q_D(QAVPlayer);
+    if (d->directIO == direct)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->directIO << "->" << direct;
+    d->directIO = direct;
+    emit directIOChanged(direct);
+}
+
+bool QAVPlayer::isFileMapping() const
+{
+    Q_D(const QAVPlayer);
+    return d->fileMapping;
+}
+
+void QAVPlayer::setFileMapping(bool mapping)
+{
+    Q_D(QAVPlayer);
+    if (d->fileMapping == mapping)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->fileMapping << "->" << mapping;
+    d->fileMapping = mapping;
+    emit fileMappingChanged(mapping);
+}
+
+int QAVPlayer::ioBufferSize() const
+{
+    Q_D(const QAVPlayer);
+    return d->ioBufferSize;
+}
+
+void QAVPlayer::setIOBufferSize(int size)
+{
+    Q_D(QAVPlayer);
+    size = qMax(size, 0);
+    if (d->ioBufferSize == size)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->ioBufferSize << "->" << size;
+    d->ioBufferSize = size;
+    emit ioBufferSizeChanged(size);
+}
+
+qint64 QAVPlayer::readAheadBytes() const
+{
+    Q_D(const QAVPlayer);
+    return d->readAheadBytes;
+}
+
+void QAVPlayer::setReadAheadBytes(qint64 bytes)
+{
+    Q_D(QAVPlayer);
+    bytes = qMax<qint64>(bytes, 0);
+    if (d->readAheadBytes == bytes)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->readAheadBytes << "->" << bytes;
+    d->readAheadBytes = bytes;
+    emit readAheadBytesChanged(bytes);
+}
+
+qint64 QAVPlayer::readAheadDuration() const
+{
+    Q_D(const QAVPlayer);
+    return d->readAheadDuration;
+}
+
+void QAVPlayer::setReadAheadDuration(qint64 ms)
+{
+    Q_D(QAVPlayer);
+    ms = qMax<qint64>(ms, 0);
+    if (d->readAheadDuration == ms)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->readAheadDuration << "->" << ms;
+    d->readAheadDuration = ms;
+    emit readAheadDurationChanged(ms);
+}
+
+qint64 QAVPlayer::framePoolSize() const
+{
+    Q_D(const QAVPlayer);
+    return d->demuxer.framePoolSize();
+}
+
+void QAVPlayer::setFramePoolSize(qint64 bytes)
+{
+    Q_D(QAVPlayer);
+    bytes = qMax<qint64>(bytes, 0);
+    qint64 current = framePoolSize();
+    if (bytes == current)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << current << "->" << bytes;
+    d->demuxer.setFramePoolSize(bytes);
+    emit framePoolSizeChanged(bytes);
+}
+
+QAVPlayer::FramePoolStatistics QAVPlayer::framePoolStatistics() const
+{
+    Q_D(const QAVPlayer);
+    FramePoolStatistics result;
+    for (const auto &stream : d->demuxer.currentVideoStreams()) {
+        if (!stream.codec())
+            continue;
+        const auto stats = static_cast<QAVVideoCodec *>(stream.codec().data())->framePoolStatistics();
+        result.hits += stats.hits;
+        result.misses += stats.misses;
+        result.fallbacks += stats.fallbacks;
+        result.bytes += stats.bytes;
+        result.highWaterBytes += stats.highWaterBytes;
+    }
+    return result;
+}
+
+template <class T>
+static QAVPlayer::QueueStatistics queueStatistics(const QAVPacketQueue<T> &queue, const QAVQueueClock &clock)
+{
+    QAVPlayer::QueueStatistics result;
+    result.packets = queue.count();
+    result.packetBytes = queue.bytes();
+    result.enoughPackets = queue.enough();
+    result.frames = queue.framesCount();
+    result.frameBytes = queue.framesBytes();
+    const qint64 frames = queue.decodedFrames();
+    result.decodeTime = frames > 0 ? queue.decodeTime() / frames / 1000 : 0;
+    result.lateness = clock.lateness() * 1000;
+    return result;
+}
+
+int QAVPlayer::maxInFlightFrames() const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->frameBudget->mutex);
+    return d->frameBudget->max;
+}
+
+void QAVPlayer::setMaxInFlightFrames(int frames)
+{
+    Q_D(QAVPlayer);
+    frames = qMax(frames, 0);
+    {
+        QMutexLocker locker(&d->frameBudget->mutex);
+        if (d->frameBudget->max == frames)
+            return;
+
+        qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << d->frameBudget->max << "->" << frames;
+        d->frameBudget->max = frames;
+    }
+    d->frameBudget->wake();
+    emit maxInFlightFramesChanged(frames);
+}
+
+int QAVPlayer::inFlightFrames() const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->frameBudget->mutex);
+    return d->frameBudget->inFlight;
+}
+
+QAVPlayer::Statistics QAVPlayer::statistics() const
+{
+    Q_D(const QAVPlayer);
+    Statistics result;
+    result.video = queueStatistics(d->videoQueue, d->videoClock);
+    result.audio = queueStatistics(d->audioQueue, d->audioClock);
+    result.subtitle = queueStatistics(d->subtitleQueue, d->subtitleClock);
+    const qint64 frames = d->filterCount;
+    result.filterTime = frames > 0 ? d->filterTime / frames / 1000 : 0;
+    if (!d->demuxer.currentVideoStreams().isEmpty() && !d->demuxer.currentAudioStreams().isEmpty())
+        result.avDrift = (d->videoClock.pts() - d->audioClock.pts()) * 1000;
+    result.droppedFrames = droppedFrames();
+    result.skippedFrames = skippedFrames();
+    result.readBytes = d->readBytes;
+    const qint64 readTime = d->readTime;
+    result.readThroughput = readTime > 0 ? qint64(double(result.readBytes) * 1000000000 / readTime) : 0;
+    result.seekLatency = d->seekLatency;
+    result.inFlightFrames = inFlightFrames();
+    return result;
+}
+
+int QAVPlayer::statisticsInterval() const
+{
+    Q_D(const QAVPlayer);
+    return d->statisticsTimer.isActive() ? d->statisticsTimer.interval() : 0;
+}
+
+void QAVPlayer::setStatisticsInterval(int ms)
+{
+    Q_D(QAVPlayer);
+    ms = qMax(ms, 0);
+    int current = statisticsInterval();
+    if (ms == current)
+        return;
+
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << current << "->" << ms;
+    if (ms > 0)
+        d->statisticsTimer.start(ms);
+    else
+        d->statisticsTimer.stop();
+    emit statisticsIntervalChanged(ms);
+}
+
 #ifndef QT_NO_DEBUG_STREAM
 QDebug operator<<(QDebug dbg, QAVPlayer::State state)
 {
@@ -1372,6 +2060,24 @@ QDebug operator<<(QDebug dbg, QAVPlayer::Error err)
             return dbg << QString(QLatin1String("UserType(%1)" )).arg(int(err)).toLatin1().constData();
     }
 }
+
+QDebug operator<<(QDebug dbg, QAVPlayer::DecodingThreadType type)
+{
+    QDebugStateSaver saver(dbg);
+    dbg.nospace();
+    switch (type) {
+        case QAVPlayer::DefaultThreading:
+            return dbg << "DefaultThreading";
+        case QAVPlayer::FrameThreading:
+            return dbg << "FrameThreading";
+        case QAVPlayer::SliceThreading:
+            return dbg << "SliceThreading";
+        case QAVPlayer::FrameAndSliceThreading:
+            return dbg << "FrameAndSliceThreading";
+        default:
+            return dbg << QString(QLatin1String("UserType(%1)" )).arg(int(type)).toLatin1().constData();
+    }
+}
 #endif
 
 Q_DECLARE_METATYPE(PendingMediaStatus)
@@ -26,6 +26,7 @@ class Q_AVPLAYER_EXPORT QAVPlayer : public QObject
     Q_ENUMS(State)
     Q_ENUMS(MediaStatus)
     Q_ENUMS(Error)
+    Q_ENUMS(DecodingThreadType)
 
 public:
     enum State
@@ -50,10 +51,67 @@ public:
         FilterError
     };
 
+    enum DecodingThreadType
+    {
+        DefaultThreading = 0,
+        FrameThreading = 0x1,
+        SliceThreading = 0x2,
+        FrameAndSliceThreading = FrameThreading | SliceThreading
+    };
+
+    struct FramePoolStatistics
+    {
+        // Video buffers reused from the pool
+        qint64 hits = 0;
+        // Video buffers allocated by the pool
+        qint64 misses = 0;
+        // Video buffers allocated without the pool when it is full
+        qint64 fallbacks = 0;
+        qint64 bytes = 0;
+        qint64 highWaterBytes = 0;
+    };
+
+    struct QueueStatistics
+    {
+        int packets = 0;
+        qint64 packetBytes = 0;
+        bool enoughPackets = false;
+        int frames = 0;
+        qint64 frameBytes = 0;
+        // Average decoding time per frame in microseconds
+        qint64 decodeTime = 0;
+        // How late the last frame has been sent after its time in ms
+        double lateness = 0;
+    };
+
+    struct Statistics
+    {
+        QueueStatistics video;
+        QueueStatistics audio;
+        QueueStatistics subtitle;
+        // Average filtering time per frame in microseconds
+        qint64 filterTime = 0;
+        // Video clock ahead of audio clock in ms
+        double avDrift = 0;
+        qint64 droppedFrames = 0;
+        qint64 skippedFrames = 0;
+        qint64 readBytes = 0;
+        // Bytes per second while reading the packets
+        qint64 readThroughput = 0;
+        // From the last seek request until the seeked() signal in ms rounded up,
+        // 0 if no seek has finished
+        qint64 seekLatency = 0;
+        // Emitted frames still referenced by the consumers
+        int inFlightFrames = 0;
+    };
+
     QAVPlayer(QObject *parent = nullptr);
     ~QAVPlayer();
 
     void setSource(const QString &url, QIODevice *dev = nullptr);
+    // Plays from the memory, which must be valid until another source is set.
+    // Always reloaded, even if the url is not changed
+    void setSource(const QString &url, const uchar *data, qint64 size);
     QString source() const;
 
     QList<QAVStream> availableVideoStreams() const;
@@ -99,10 +157,79 @@ public:
     QMap<QString, QString> inputOptions() const;
     void setInputOptions(const QMap<QString, QString> &opts);
 
+    // 0 means auto detect, applied on next setSource()
+    int decodingThreads() const;
+    void setDecodingThreads(int threads);
+
+    DecodingThreadType decodingThreadType() const;
+    void setDecodingThreadType(DecodingThreadType type);
+
+    // Seeks only to the nearest keyframes and coalesces pending seeks,
+    // disabling it seeks precisely to the last requested position
+    bool isScrubbing() const;
+    void setScrubbing(bool scrubbing);
+
+    // Drops late video frames before the filters when synced to audio,
+    // and lets the decoder skip frames if the lag is sustained
+    bool isFrameDropping() const;
+    void setFrameDropping(bool drop);
+    qint64 droppedFrames() const;
+    qint64 skippedFrames() const;
+
+    // Decodes frames in a separate thread up to the limits,
+    // 0 frames disables, 0 bytes means no limit. Applied on next setSource()
+    int decodeAheadFrames() const;
+    void setDecodeAheadFrames(int frames);
+
+    qint64 decodeAheadBytes() const;
+    void setDecodeAheadBytes(qint64 bytes);
+
+    // Reads the QIODevice on the demuxer thread instead of its own thread,
+    // it must not be used by other threads while playing. Applied on next setSource()
+    bool isDirectIO() const;
+    void setDirectIO(bool direct);
+
+    // Maps local files to the memory instead of reading them. Applied on next setSource()
+    bool isFileMapping() const;
+    void setFileMapping(bool mapping);
+
+    // AVIO buffer size and background read-ahead limits of QIODevice sources,
+    // 0 means default buffer size. Read-ahead stops at the smallest limit set,
+    // 0 leaves a limit unset and both 0 disable read-ahead. Applied on next setSource()
+    int ioBufferSize() const;
+    void setIOBufferSize(int size);
+
+    qint64 readAheadBytes() const;
+    void setReadAheadBytes(qint64 bytes);
+
+    qint64 readAheadDuration() const;
+    void setReadAheadDuration(qint64 ms);
+
+    // Decodes video to buffers reused from a pool limited by bytes,
+    // 0 disables the pool. Applied on next setSource()
+    qint64 framePoolSize() const;
+    void setFramePoolSize(qint64 bytes);
+    FramePoolStatistics framePoolStatistics() const;
+
+    // Blocks emitting frames while the consumers keep references to this number
+    // of emitted frames, 0 means no limit. Frames connected by queued connections
+    // are kept until delivered, so the memory stays bounded even if not synced.
+    // Must be larger than the number of frames the consumers store
+    int maxInFlightFrames() const;
+    void setMaxInFlightFrames(int frames);
+    int inFlightFrames() const;
+
+    // Snapshot of the pipeline since the source is set
+    Statistics statistics() const;
+    // Emits statisticsUpdated() periodically, 0 disables
+    int statisticsInterval() const;
+    void setStatisticsInterval(int ms);
+
 public Q_SLOTS:
     void play();
     void pause();
     void stop();
+    // Frames decoded before the position are dropped before the filters
     void seek(qint64 position);
     void setSpeed(qreal rate);
     void stepForward();
@@ -131,6 +258,21 @@ Q_SIGNALS:
     void inputFormatChanged(const QString &format);
     void inputVideoCodecChanged(const QString &codec);
     void inputOptionsChanged(const QMap<QString, QString> &opts);
+    void decodingThreadsChanged(int threads);
+    void decodingThreadTypeChanged(QAVPlayer::DecodingThreadType type);
+    void scrubbingChanged(bool scrubbing);
+    void frameDroppingChanged(bool drop);
+    void decodeAheadFramesChanged(int frames);
+    void decodeAheadBytesChanged(qint64 bytes);
+    void directIOChanged(bool direct);
+    void fileMappingChanged(bool mapping);
+    void ioBufferSizeChanged(int size);
+    void readAheadBytesChanged(qint64 bytes);
+    void readAheadDurationChanged(qint64 ms);
+    void framePoolSizeChanged(qint64 bytes);
+    void maxInFlightFramesChanged(int frames);
+    void statisticsIntervalChanged(int ms);
+    void statisticsUpdated(const QAVPlayer::Statistics &stats);
 
     void videoFrame(const QAVVideoFrame &frame);
     void audioFrame(const QAVAudioFrame &frame);
@@ -148,11 +290,14 @@ private:
 Q_AVPLAYER_EXPORT QDebug operator<<(QDebug, QAVPlayer::State);
 Q_AVPLAYER_EXPORT QDebug operator<<(QDebug, QAVPlayer::MediaStatus);
 Q_AVPLAYER_EXPORT QDebug operator<<(QDebug, QAVPlayer::Error);
+Q_AVPLAYER_EXPORT QDebug operator<<(QDebug, QAVPlayer::DecodingThreadType);
 #endif
 
 Q_DECLARE_METATYPE(QAVPlayer::State)
 Q_DECLARE_METATYPE(QAVPlayer::MediaStatus)
 Q_DECLARE_METATYPE(QAVPlayer::Error)
+Q_DECLARE_METATYPE(QAVPlayer::DecodingThreadType)
+Q_DECLARE_METATYPE(QAVPlayer::Statistics)
 
 QT_END_NAMESPACE
 
@@ -0,0 +1,123 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVRINGBUFFER_P_H
+#define QAVRINGBUFFER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+// Lock-free ring of bytes for one producer and one consumer.
+// Resizing is allowed only when neither of them uses the buffer
+class QAVRingBuffer
+{
+public:
+    // Rounds up the capacity to the power of two and drops the data
+    void resize(size_t size)
+    {
+        size_t capacity = 1;
+        while (capacity < size)
+            capacity <<= 1;
+        m_data.assign(capacity, 0);
+        m_head = 0;
+        m_tail = 0;
+        m_empty = false;
+    }
+
+    size_t capacity() const
+    {
+        return m_data.size();
+    }
+
+    // Bytes available to read
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    // Total bytes read, used to check if the consumer makes progress
+    size_t readPosition() const
+    {
+        return m_head.load(std::memory_order_acquire);
+    }
+
+    // Called only by the producer
+    size_t write(const char *data, size_t len)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t n = qMin(len, capacity() - (tail - head));
+        copy(tail, n, [&](size_t pos, size_t offset, size_t count) {
+            memcpy(m_data.data() + pos, data + offset, count);
+        });
+        m_tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // Called only by the consumer
+    size_t read(char *data, size_t len)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        const size_t n = qMin(len, tail - head);
+        copy(head, n, [&](size_t pos, size_t offset, size_t count) {
+            memcpy(data + offset, m_data.data() + pos, count);
+        });
+        m_head.store(head + n, std::memory_order_release);
+        // Counts each time the consumer runs out of data
+        if (len > 0 && n == 0 && !m_empty)
+            m_underruns.fetch_add(1, std::memory_order_relaxed);
+        if (len > 0)
+            m_empty = n == 0;
+        return n;
+    }
+
+    qint64 underruns() const
+    {
+        return m_underruns.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Splits the range at the end of the buffer
+    template <class F>
+    void copy(size_t from, size_t len, F f)
+    {
+        if (!len)
+            return;
+        const size_t pos = from & (capacity() - 1);
+        const size_t first = qMin(len, capacity() - pos);
+        f(pos, 0, first);
+        if (first < len)
+            f(0, first, len - first);
+    }
+
+    std::vector<char> m_data;
+    std::atomic<size_t> m_head { 0 };
+    std::atomic<size_t> m_tail { 0 };
+    std::atomic<qint64> m_underruns { 0 };
+    // Used only by the consumer
+    bool m_empty = false;
+};
+
+QT_END_NAMESPACE
+
+#endif
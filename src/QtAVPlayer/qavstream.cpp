@@ -16,27 +16,32 @@ extern "C" {
 
 QT_BEGIN_NAMESPACE
 
-class QAVStreamPrivate
+class QAVStreamPrivate : public QSharedData
 {
-    Q_DECLARE_PUBLIC(QAVStream)
 public:
-    QAVStreamPrivate(QAVStream *q) : q_ptr(q) { }
-
-    QAVStream *q_ptr = nullptr;
     int index = -1;
     AVStream *stream = nullptr;
     QSharedPointer<QAVCodec> codec;
 };
 
+Q_GLOBAL_STATIC_WITH_ARGS(QExplicitlySharedDataPointer<QAVStreamPrivate>, sharedNull, (new QAVStreamPrivate))
+
+static QAVStreamPrivate *nullStream()
+{
+    // Streams could still be created while static objects are destroyed
+    return !sharedNull.isDestroyed() ? sharedNull->data() : new QAVStreamPrivate;
+}
+
 QAVStream::QAVStream(QObject *parent)
-    : QObject(parent)
-    , d_ptr(new QAVStreamPrivate(this))
+    : d_ptr(nullStream())
 {
+    Q_UNUSED(parent);
 }
 
 QAVStream::QAVStream(int index, AVStream *stream, const QSharedPointer<QAVCodec> &codec, QObject *parent)
-    : QAVStream(parent)
+    : d_ptr(new QAVStreamPrivate)
 {
+    Q_UNUSED(parent);
     d_ptr->index = index;
     d_ptr->stream = stream;
     d_ptr->codec = codec;
@@ -47,16 +52,25 @@ QAVStream::~QAVStream()
 }
 
 QAVStream::QAVStream(const QAVStream &other)
-    : QAVStream()
+    : d_ptr(other.d_ptr)
+{
+}
+
+// Moved-from streams stay valid
+QAVStream::QAVStream(QAVStream &&other) noexcept
+    : d_ptr(other.d_ptr)
 {
-    *this = other;
 }
 
 QAVStream &QAVStream::operator=(const QAVStream &other)
 {
-    d_ptr->index = other.d_ptr->index;
-    d_ptr->stream = other.d_ptr->stream;
-    d_ptr->codec = other.d_ptr->codec;
+    d_ptr = other.d_ptr;
+    return *this;
+}
+
+QAVStream &QAVStream::operator=(QAVStream &&other) noexcept
+{
+    d_ptr.swap(other.d_ptr);
     return *this;
 }
 
@@ -12,21 +12,24 @@
 #include <QMap>
 #include <QObject>
 #include <QSharedPointer>
-#include <memory>
+#include <QExplicitlySharedDataPointer>
 
 QT_BEGIN_NAMESPACE
 
 struct AVStream;
 class QAVCodec;
 class QAVStreamPrivate;
-class Q_AVPLAYER_EXPORT QAVStream : public QObject
+// Implicitly shared, default constructed streams do not allocate
+class Q_AVPLAYER_EXPORT QAVStream
 {
 public:
     QAVStream(QObject *parent = nullptr);
     QAVStream(int index, AVStream *stream = nullptr, const QSharedPointer<QAVCodec> &codec = {}, QObject *parent = nullptr);
     QAVStream(const QAVStream &other);
+    QAVStream(QAVStream &&other) noexcept;
     ~QAVStream();
     QAVStream &operator=(const QAVStream &other);
+    QAVStream &operator=(QAVStream &&other) noexcept;
     operator bool() const;
 
     int index() const;
@@ -38,10 +41,12 @@ public:
     QSharedPointer<QAVCodec> codec() const;
 
 private:
-    std::unique_ptr<QAVStreamPrivate> d_ptr;
+    QExplicitlySharedDataPointer<QAVStreamPrivate> d_ptr;
     Q_DECLARE_PRIVATE(QAVStream)
 };
 
+Q_DECLARE_TYPEINFO(QAVStream, Q_MOVABLE_TYPE);
+
 bool operator==(const QAVStream &lhs, const QAVStream &rhs);
 
 Q_DECLARE_METATYPE(QAVStream)
@@ -23,15 +23,21 @@ QAVStreamFrame::QAVStreamFrame(QObject *parent)
 }
 
 QAVStreamFrame::QAVStreamFrame(const QAVStreamFrame &other)
-    : QAVStreamFrame(nullptr)
+    : d_ptr(other.d_ptr)
 {
-    *this = other;
+}
+
+QAVStreamFrame::QAVStreamFrame(QAVStreamFrame &&other) noexcept
+{
+    d_ptr.swap(other.d_ptr);
+    if (d_ptr)
+        other.d_ptr = QExplicitlySharedDataPointer<QAVStreamFramePrivate>(d_ptr->empty());
 }
 
 QAVStreamFrame::QAVStreamFrame(QAVStreamFramePrivate &d, QObject *parent)
-    : QObject(parent)
-    , d_ptr(&d)
+    : d_ptr(&d)
 {
+    Q_UNUSED(parent);
 }
 
 QAVStreamFrame::~QAVStreamFrame()
@@ -45,20 +51,32 @@ QAVStream QAVStreamFrame::stream() const
 
 void QAVStreamFrame::setStream(const QAVStream &stream)
 {
+    detach();
     Q_D(QAVStreamFrame);
     d->stream = stream;
 }
 
 QAVStreamFrame &QAVStreamFrame::operator=(const QAVStreamFrame &other)
 {
-    d_ptr->stream = other.d_ptr->stream;
+    d_ptr = other.d_ptr;
+    return *this;
+}
+
+QAVStreamFrame &QAVStreamFrame::operator=(QAVStreamFrame &&other) noexcept
+{
+    if (this != &other) {
+        d_ptr.swap(other.d_ptr);
+        // The previous data is released now, not when the other frame is destroyed
+        if (d_ptr)
+            other.d_ptr = QExplicitlySharedDataPointer<QAVStreamFramePrivate>(d_ptr->empty());
+    }
     return *this;
 }
 
 QAVStreamFrame::operator bool() const
 {
     Q_D(const QAVStreamFrame);
-    return d->stream;
+    return d && d->stream;
 }
 
 double QAVStreamFrame::pts() const
@@ -79,4 +97,15 @@ int QAVStreamFrame::receive()
     return d->stream ? d->stream.codec()->read(*this) : 0;
 }
 
+void QAVStreamFrame::detach()
+{
+    if (d_ptr && d_ptr->ref.loadAcquire() != 1)
+        d_ptr = QExplicitlySharedDataPointer<QAVStreamFramePrivate>(d_ptr->clone());
+}
+
+bool QAVStreamFrame::isDetached() const
+{
+    return d_ptr && d_ptr->ref.loadAcquire() == 1;
+}
+
 QT_END_NAMESPACE
@@ -11,18 +11,22 @@
 #include <QtAVPlayer/qtavplayerglobal.h>
 #include <QtAVPlayer/qavstream.h>
 #include <QObject>
-#include <memory>
+#include <QExplicitlySharedDataPointer>
 
 QT_BEGIN_NAMESPACE
 
 class QAVStreamFramePrivate;
-class Q_AVPLAYER_EXPORT QAVStreamFrame : public QObject
+// Implicitly shared, copies only increase the reference count.
+// Moved-from frames are empty
+class Q_AVPLAYER_EXPORT QAVStreamFrame
 {
 public:
     QAVStreamFrame(QObject *parent = nullptr);
     QAVStreamFrame(const QAVStreamFrame &other);
+    QAVStreamFrame(QAVStreamFrame &&other) noexcept;
     ~QAVStreamFrame();
     QAVStreamFrame &operator=(const QAVStreamFrame &other);
+    QAVStreamFrame &operator=(QAVStreamFrame &&other) noexcept;
 
     QAVStream stream() const;
     void setStream(const QAVStream &stream);
@@ -34,11 +38,18 @@ public:
     // Receives a data from the codec from the stream
     int receive();
 
+    // Makes own copy of the data if it is shared with other frames
+    void detach();
+    bool isDetached() const;
+
 protected:
     QAVStreamFrame(QAVStreamFramePrivate &d, QObject *parent = nullptr);
 
-    std::unique_ptr<QAVStreamFramePrivate> d_ptr;
+    QExplicitlySharedDataPointer<QAVStreamFramePrivate> d_ptr;
     Q_DECLARE_PRIVATE(QAVStreamFrame)
+
+private:
+    friend class QAVPlayerPrivate;
 };
 
 QT_END_NAMESPACE
@@ -20,22 +20,55 @@
 //
 
 #include "qavstream.h"
+#include <QSharedData>
 #include <cmath>
+#include <memory>
 
 QT_BEGIN_NAMESPACE
 
-class QAVStreamFramePrivate
+class QAVStreamFramePrivate : public QSharedData
 {
 public:
     QAVStreamFramePrivate() = default;
+    QAVStreamFramePrivate(const QAVStreamFramePrivate &other)
+        : QSharedData(other)
+        , stream(other.stream)
+        , onRelease(other.onRelease)
+    {
+    }
+
     virtual ~QAVStreamFramePrivate() = default;
 
+    // Used to detach, the copy does not share any state with this one
+    virtual QAVStreamFramePrivate *clone() const { return new QAVStreamFramePrivate(*this); }
+    // Empty data of the same type, left in the moved-from frames
+    virtual QAVStreamFramePrivate *empty() const;
+
     virtual double pts() const { return NAN; }
     virtual double duration() const { return 0.0; }
 
     QAVStream stream;
+    // Shared with the detached copies, its deleter is called when the last one is destroyed
+    std::shared_ptr<void> onRelease;
 };
 
+// Shared by all moved-from frames of the type, never destroyed
+template<class T>
+QAVStreamFramePrivate *qavEmptyFramePrivate()
+{
+    static T *d = [] {
+        auto p = new T;
+        p->ref.ref();
+        return p;
+    }();
+    return d;
+}
+
+inline QAVStreamFramePrivate *QAVStreamFramePrivate::empty() const
+{
+    return qavEmptyFramePrivate<QAVStreamFramePrivate>();
+}
+
 QT_END_NAMESPACE
 
 #endif
@@ -19,6 +19,9 @@ QT_BEGIN_NAMESPACE
 class QAVSubtitleFramePrivate : public QAVStreamFramePrivate
 {
 public:
+    QAVStreamFramePrivate *clone() const override { return new QAVSubtitleFramePrivate(*this); }
+    QAVStreamFramePrivate *empty() const override { return qavEmptyFramePrivate<QAVSubtitleFramePrivate>(); }
+
     QSharedPointer<AVSubtitle> subtitle;
 
     double pts() const override;
@@ -43,17 +46,24 @@ QAVSubtitleFrame::~QAVSubtitleFrame()
 }
 
 QAVSubtitleFrame::QAVSubtitleFrame(const QAVSubtitleFrame &other)
-    : QAVSubtitleFrame(nullptr)
+    : QAVStreamFrame(other)
+{
+}
+
+QAVSubtitleFrame::QAVSubtitleFrame(QAVSubtitleFrame &&other) noexcept
+    : QAVStreamFrame(std::move(other))
 {
-    operator=(other);
 }
 
 QAVSubtitleFrame &QAVSubtitleFrame::operator=(const QAVSubtitleFrame &other)
 {
-    Q_D(QAVSubtitleFrame);
     QAVStreamFrame::operator=(other);
-    d->subtitle = static_cast<QAVSubtitleFramePrivate *>(other.d_ptr.get())->subtitle;
+    return *this;
+}
 
+QAVSubtitleFrame &QAVSubtitleFrame::operator=(QAVSubtitleFrame &&other) noexcept
+{
+    QAVStreamFrame::operator=(std::move(other));
     return *this;
 }
 
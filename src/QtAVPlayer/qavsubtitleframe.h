@@ -20,7 +20,9 @@ public:
     QAVSubtitleFrame(QObject *parent = nullptr);
     ~QAVSubtitleFrame();
     QAVSubtitleFrame(const QAVSubtitleFrame &other);
+    QAVSubtitleFrame(QAVSubtitleFrame &&other) noexcept;
     QAVSubtitleFrame &operator=(const QAVSubtitleFrame &other);
+    QAVSubtitleFrame &operator=(QAVSubtitleFrame &&other) noexcept;
 
     AVSubtitle *subtitle() const;
 
@@ -28,6 +30,8 @@ private:
     Q_DECLARE_PRIVATE(QAVSubtitleFrame)
 };
 
+Q_DECLARE_TYPEINFO(QAVSubtitleFrame, Q_MOVABLE_TYPE);
+
 Q_DECLARE_METATYPE(QAVSubtitleFrame)
 
 QT_END_NAMESPACE
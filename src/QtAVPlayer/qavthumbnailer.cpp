@@ -0,0 +1,167 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavthumbnailer.h"
+#include "qavdemuxer_p.h"
+#include "qavvideocodec_p.h"
+#include "qavpacket_p.h"
+#include <QtMath>
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+class QAVThumbnailerPrivate
+{
+public:
+    QAVVideoFrame decodeKeyframe(double pos);
+
+    QAVDemuxer demuxer;
+    QSize size;
+    // Reused by the tiles of the same size
+    QAVVideoFrame tile;
+};
+
+QAVVideoFrame QAVThumbnailerPrivate::decodeKeyframe(double pos)
+{
+    const auto streams = demuxer.currentVideoStreams();
+    if (streams.isEmpty())
+        return {};
+
+    if (demuxer.seek(pos) < 0 && pos > 0)
+        return {};
+    demuxer.flushCodecBuffers();
+
+    const QAVStream stream = streams.first();
+    QList<QAVFrame> frames;
+    while (frames.isEmpty()) {
+        QAVPacket pkt = demuxer.read();
+        if (!pkt)
+            break;
+        if (pkt.packet()->stream_index == stream.index())
+            demuxer.decode(pkt, frames);
+    }
+
+    // Drains the decoder if the keyframe is close to the end
+    if (frames.isEmpty()) {
+        QAVPacket pkt;
+        pkt.setStream(stream);
+        demuxer.decode(pkt, frames);
+    }
+
+    return !frames.isEmpty() ? QAVVideoFrame(frames.first()) : QAVVideoFrame();
+}
+
+QAVThumbnailer::QAVThumbnailer(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new QAVThumbnailerPrivate)
+{
+}
+
+QAVThumbnailer::~QAVThumbnailer()
+{
+}
+
+int QAVThumbnailer::load(const QString &url, const QSize &size)
+{
+    Q_D(QAVThumbnailer);
+    unload();
+    if (size.isEmpty())
+        return AVERROR(EINVAL);
+
+    d->size = size;
+    d->demuxer.setVideoLowresSize(size);
+    int ret = d->demuxer.load(url);
+    if (ret < 0)
+        return ret;
+
+    const auto streams = d->demuxer.currentVideoStreams();
+    if (streams.isEmpty()) {
+        qWarning() << "No video stream found:" << url;
+        d->demuxer.unload();
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+
+    // Only keyframes are needed
+    for (const auto &stream : streams)
+        static_cast<QAVVideoCodec *>(stream.codec().data())->setSkipLevel(4);
+
+    return 0;
+}
+
+void QAVThumbnailer::unload()
+{
+    Q_D(QAVThumbnailer);
+    d->demuxer.unload();
+    d->size = {};
+}
+
+QSize QAVThumbnailer::size() const
+{
+    return d_func()->size;
+}
+
+double QAVThumbnailer::duration() const
+{
+    return d_func()->demuxer.duration();
+}
+
+QAVVideoFrame QAVThumbnailer::spriteSheet(int count, int columns)
+{
+    Q_D(QAVThumbnailer);
+    if (count <= 0 || d->size.isEmpty() || d->demuxer.currentVideoStreams().isEmpty())
+        return {};
+
+    if (columns <= 0)
+        columns = qCeil(qSqrt(count));
+    columns = qMin(columns, count);
+    const int rows = (count + columns - 1) / columns;
+    const int w = d->size.width();
+    const int h = d->size.height();
+
+    QAVVideoFrame sheet(QSize(columns * w, rows * h), AV_PIX_FMT_RGB32);
+    AVFrame *dst = sheet.frame();
+    if (!dst->data[0]) {
+        qWarning() << "Could not allocate sprite sheet:" << columns * w << "x" << rows * h;
+        return {};
+    }
+    for (int y = 0; y < dst->height; ++y)
+        memset(dst->data[0] + y * dst->linesize[0], 0, dst->width * 4);
+
+    const double duration = d->demuxer.duration();
+    for (int i = 0; i < count; ++i) {
+        const double pos = duration * (i + 0.5) / count;
+        QAVVideoFrame frame = d->decodeKeyframe(pos);
+        if (!frame)
+            continue;
+
+        const QSize scaled = frame.size().scaled(d->size, Qt::KeepAspectRatio);
+        if (scaled.isEmpty())
+            continue;
+
+        // Colors of the source are converted the same way as for the renderers
+        if (!frame.convertTo(AV_PIX_FMT_RGB32, scaled, d->tile, QAVVideoFrame::FastBilinearScaling))
+            continue;
+
+        // The tile is centered within the cell
+        const AVFrame *src = std::as_const(d->tile).frame();
+        const int x = (i % columns) * w + (w - scaled.width()) / 2;
+        const int y = (i / columns) * h + (h - scaled.height()) / 2;
+        for (int row = 0; row < scaled.height(); ++row) {
+            memcpy(dst->data[0] + (y + row) * dst->linesize[0] + x * 4,
+                   src->data[0] + row * src->linesize[0],
+                   scaled.width() * 4);
+        }
+    }
+
+    return sheet;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,48 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVTHUMBNAILER_H
+#define QAVTHUMBNAILER_H
+
+#include <QtAVPlayer/qavvideoframe.h>
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QObject>
+#include <QSize>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVThumbnailerPrivate;
+class Q_AVPLAYER_EXPORT QAVThumbnailer : public QObject
+{
+    Q_OBJECT
+public:
+    QAVThumbnailer(QObject *parent = nullptr);
+    ~QAVThumbnailer();
+
+    // Frames are decoded at reduced resolution if supported, but not less than the size
+    int load(const QString &url, const QSize &size);
+    void unload();
+
+    QSize size() const;
+    double duration() const;
+
+    // Decodes keyframes at evenly spaced positions and puts them to one RGB32 frame,
+    // 0 columns makes the sheet close to a square
+    QAVVideoFrame spriteSheet(int count, int columns = 0);
+
+protected:
+    std::unique_ptr<QAVThumbnailerPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVThumbnailer)
+    Q_DECLARE_PRIVATE(QAVThumbnailer)
+};
+
+QT_END_NAMESPACE
+
+#endif
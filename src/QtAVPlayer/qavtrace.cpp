@@ -0,0 +1,236 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavtrace_p.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QDebug>
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+std::atomic<bool> QAVTrace::s_enabled { false };
+std::atomic<int> QAVTrace::s_maxEvents { 1 << 16 };
+
+namespace {
+
+struct Event
+{
+    const char *name = nullptr;
+    qint64 start = 0;
+    qint64 end = 0;
+};
+
+// Written only by the thread that holds it, read when the trace is exported.
+// Released when the thread exits or changes its name, and reused by other threads
+struct ThreadBuffer
+{
+    explicit ThreadBuffer(int tid) : tid(tid), events(size_t(QAVTrace::maxEvents())) { }
+
+    const int tid = 0;
+    std::atomic<const char *> name { nullptr };
+    std::vector<Event> events;
+    std::atomic<size_t> count { 0 };
+    std::atomic<qint64> dropped { 0 };
+    // Guarded by the registry mutex
+    bool used = false;
+};
+
+struct Registry
+{
+    Registry() { timer.start(); }
+
+    QElapsedTimer timer;
+    QMutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+Registry &registry()
+{
+    static Registry r;
+    return r;
+}
+
+// Prefers a free buffer with the same name, then an empty one
+ThreadBuffer *acquireBuffer(const char *name)
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    ThreadBuffer *result = nullptr;
+    for (auto &b : r.buffers) {
+        if (b->used)
+            continue;
+        if (qstrcmp(b->name, name) == 0) {
+            result = b.get();
+            break;
+        }
+        if (!result && b->count == 0)
+            result = b.get();
+    }
+    if (!result) {
+        r.buffers.emplace_back(new ThreadBuffer(int(r.buffers.size()) + 1));
+        result = r.buffers.back().get();
+    }
+    result->name = name;
+    result->used = true;
+    return result;
+}
+
+void releaseBuffer(ThreadBuffer *&buffer)
+{
+    if (!buffer)
+        return;
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    buffer->used = false;
+    buffer = nullptr;
+}
+
+struct ThreadSlot
+{
+    ~ThreadSlot() { releaseBuffer(buffer); }
+
+    ThreadBuffer *buffer = nullptr;
+    const char *name = nullptr;
+};
+
+thread_local ThreadSlot t_slot;
+
+ThreadBuffer *threadBuffer()
+{
+    if (!t_slot.buffer)
+        t_slot.buffer = acquireBuffer(t_slot.name);
+    return t_slot.buffer;
+}
+
+}
+
+void QAVTrace::setEnabled(bool enabled)
+{
+    if (enabled)
+        registry();
+    s_enabled = enabled;
+}
+
+void QAVTrace::clear()
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (auto &b : r.buffers) {
+        b->count = 0;
+        b->dropped = 0;
+    }
+}
+
+int QAVTrace::maxEvents()
+{
+    return s_maxEvents.load(std::memory_order_relaxed);
+}
+
+void QAVTrace::setMaxEvents(int count)
+{
+    count = qMax(count, 1);
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    s_maxEvents = count;
+    for (auto &b : r.buffers) {
+        b->events.resize(size_t(count));
+        b->count = qMin(b->count.load(), size_t(count));
+    }
+}
+
+qint64 QAVTrace::droppedEvents()
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    qint64 dropped = 0;
+    for (const auto &b : r.buffers)
+        dropped += b->dropped;
+    return dropped;
+}
+
+void QAVTrace::setThreadName(const char *name)
+{
+    t_slot.name = name;
+    if (t_slot.buffer && qstrcmp(t_slot.buffer->name, name) != 0)
+        releaseBuffer(t_slot.buffer);
+}
+
+qint64 QAVTrace::now()
+{
+    return registry().timer.nsecsElapsed() / 1000;
+}
+
+void QAVTrace::record(const char *name, qint64 start, qint64 end)
+{
+    auto b = threadBuffer();
+    const size_t i = b->count.load(std::memory_order_relaxed);
+    if (i >= b->events.size()) {
+        b->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto &e = b->events[i];
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    b->count.store(i + 1, std::memory_order_release);
+}
+
+QByteArray QAVTrace::toJson()
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    QByteArray json("{\"traceEvents\":[\n");
+    bool first = true;
+    auto append = [&](const QByteArray &event) {
+        if (!first)
+            json += ",\n";
+        json += event;
+        first = false;
+    };
+
+    qint64 dropped = 0;
+    for (const auto &b : r.buffers) {
+        const char *name = b->name;
+        const QByteArray tid = QByteArray::number(b->tid);
+        append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+               + ",\"args\":{\"name\":\"" + QByteArray(name ? name : "thread") + "\"}}");
+        const size_t count = b->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const auto &e = b->events[i];
+            append("{\"name\":\"" + QByteArray(e.name) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid
+                   + ",\"ts\":" + QByteArray::number(e.start)
+                   + ",\"dur\":" + QByteArray::number(e.end - e.start) + "}");
+        }
+        if (b->dropped > 0)
+            qWarning() << "Trace events dropped:" << b->dropped.load() << "on thread" << b->tid;
+        dropped += b->dropped;
+    }
+
+    json += "\n],\"otherData\":{\"droppedEvents\":" + QByteArray::number(dropped) + "}}\n";
+    return json;
+}
+
+bool QAVTrace::save(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not save trace:" << fileName;
+        return false;
+    }
+    return file.write(toJson()) >= 0;
+}
+
+QString QAVTrace::traceFile()
+{
+    return qEnvironmentVariable("QT_AVPLAYER_TRACE");
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,101 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVTRACE_P_H
+#define QAVTRACE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+
+// Records scoped events to per-thread buffers, exported as Chrome trace JSON.
+// Enabled by setEnabled() or QT_AVPLAYER_TRACE=<file>, which is saved when a player is destroyed
+class Q_AVPLAYER_EXPORT QAVTrace
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+    // Should not be called while events are recorded
+    static void clear();
+    // Events kept per thread, later ones are dropped and counted.
+    // Should not be called while events are recorded
+    static int maxEvents();
+    static void setMaxEvents(int count);
+    // Events dropped since the last clear(), also reported by toJson()
+    static qint64 droppedEvents();
+
+    // Names the current thread in the trace, events of each name are kept apart
+    static void setThreadName(const char *name);
+    // Microseconds since the first use
+    static qint64 now();
+    // The name must be a string literal
+    static void record(const char *name, qint64 start, qint64 end);
+
+    static QByteArray toJson();
+    static bool save(const QString &fileName);
+    // File name set by QT_AVPLAYER_TRACE
+    static QString traceFile();
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<int> s_maxEvents;
+};
+
+class QAVTraceScope
+{
+public:
+    explicit QAVTraceScope(const char *name)
+        : m_name(QAVTrace::isEnabled() ? name : nullptr)
+    {
+        if (m_name)
+            m_start = QAVTrace::now();
+    }
+
+    ~QAVTraceScope()
+    {
+        if (m_name)
+            QAVTrace::record(m_name, m_start, QAVTrace::now());
+    }
+
+private:
+    Q_DISABLE_COPY(QAVTraceScope)
+    const char *m_name = nullptr;
+    qint64 m_start = 0;
+};
+
+// Names the thread until the task ends, pool threads run other tasks later
+class QAVTraceThreadName
+{
+public:
+    explicit QAVTraceThreadName(const char *name) { QAVTrace::setThreadName(name); }
+    ~QAVTraceThreadName() { QAVTrace::setThreadName(nullptr); }
+
+private:
+    Q_DISABLE_COPY(QAVTraceThreadName)
+};
+
+#define QAV_TRACE_CONCAT_(a, b) a##b
+#define QAV_TRACE_CONCAT(a, b) QAV_TRACE_CONCAT_(a, b)
+#define QAV_TRACE(name) QAVTraceScope QAV_TRACE_CONCAT(qavTraceScope, __LINE__)(name)
+
+QT_END_NAMESPACE
+
+#endif
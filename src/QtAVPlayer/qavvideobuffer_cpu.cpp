@@ -17,7 +17,7 @@ QT_BEGIN_NAMESPACE
 QAVVideoFrame::MapData QAVVideoBuffer_CPU::map()
 {
     QAVVideoFrame::MapData mapData;
-    auto frame = m_frame.frame();
+    auto frame = std::as_const(m_frame).frame();
     if (frame->format == AV_PIX_FMT_NONE)
         return mapData;
 
@@ -19,11 +19,13 @@ QAVVideoFrame::MapData QAVVideoBuffer_GPU::map()
 {
     auto mapData = m_cpu.map();
     if (mapData.format == AV_PIX_FMT_NONE) {
-        int ret = av_hwframe_transfer_data(m_cpu.frame().frame(), m_frame.frame(), 0);
+        QAVVideoFrame cpu;
+        int ret = av_hwframe_transfer_data(cpu.frame(), std::as_const(m_frame).frame(), 0);
         if (ret < 0) {
             qWarning() << "Could not av_hwframe_transfer_data:" << ret;
             return {};
         }
+        m_cpu = QAVVideoBuffer_CPU(cpu);
         m_frame = QAVVideoFrame();
         mapData = m_cpu.map();
     }
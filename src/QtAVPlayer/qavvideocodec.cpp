@@ -9,9 +9,11 @@
 #include "qavhwdevice_p.h"
 #include "qavcodec_p_p.h"
 #include "qavpacket_p.h"
+#include "qavframepool_p.h"
 #include "qavframe.h"
 #include "qavvideoframe.h"
 #include <QDebug>
+#include <atomic>
 
 extern "C" {
 #include <libavutil/pixdesc.h>
@@ -24,6 +26,11 @@ class QAVVideoCodecPrivate : public QAVCodecPrivate
 {
 public:
     QSharedPointer<QAVHWDevice> hw_device;
+    std::atomic<int> skipLevel { 0 };
+    int appliedSkipLevel = 0;
+    std::atomic<qint64> skipSent { 0 };
+    std::atomic<qint64> skipReceived { 0 };
+    QAVFramePool *framePool = nullptr;
 };
 
 static bool isSoftwarePixelFormat(AVPixelFormat from)
@@ -99,15 +106,35 @@ static AVPixelFormat negotiate_pixel_format(AVCodecContext *c, const AVPixelForm
     return pf;
 }
 
+static int get_video_buffer(AVCodecContext *c, AVFrame *frame, int flags)
+{
+    auto d = reinterpret_cast<QAVVideoCodecPrivate *>(c->opaque);
+    // Hardware frames and decoders without custom buffers use the default allocator
+    if (d->framePool
+        && !c->hw_frames_ctx
+        && isSoftwarePixelFormat(AVPixelFormat(frame->format))
+        && (c->codec->capabilities & AV_CODEC_CAP_DR1)
+        && d->framePool->getVideoBuffer(c, frame) == 0)
+    {
+        return 0;
+    }
+
+    return avcodec_default_get_buffer2(c, frame, flags);
+}
+
 QAVVideoCodec::QAVVideoCodec(QObject *parent)
     : QAVFrameCodec(*new QAVVideoCodecPrivate, parent)
 {
     d_ptr->avctx->opaque = d_ptr.get();
     d_ptr->avctx->get_format = negotiate_pixel_format;
+    d_ptr->avctx->get_buffer2 = get_video_buffer;
 }
 
 QAVVideoCodec::~QAVVideoCodec()
 {
+    Q_D(QAVVideoCodec);
+    if (d->framePool)
+        d->framePool->release();
     av_buffer_unref(&avctx()->hw_device_ctx);
 }
 
@@ -121,4 +148,65 @@ QAVHWDevice *QAVVideoCodec::device() const
     return d_func()->hw_device.data();
 }
 
+void QAVVideoCodec::setSkipLevel(int level)
+{
+    d_func()->skipLevel = qBound(0, level, 4);
+}
+
+int QAVVideoCodec::skipLevel() const
+{
+    return d_func()->skipLevel;
+}
+
+qint64 QAVVideoCodec::skippedFrames() const
+{
+    Q_D(const QAVVideoCodec);
+    return qMax<qint64>(0, d->skipSent - d->skipReceived);
+}
+
+void QAVVideoCodec::setFramePoolSize(qint64 bytes)
+{
+    Q_D(QAVVideoCodec);
+    if (avcodec_is_open(d->avctx)) {
+        qWarning() << "Frame pool could not be changed after the codec is opened";
+        return;
+    }
+
+    if (d->framePool)
+        d->framePool->release();
+    d->framePool = QAVFramePool::create(bytes);
+}
+
+QAVFramePoolStatistics QAVVideoCodec::framePoolStatistics() const
+{
+    Q_D(const QAVVideoCodec);
+    return d->framePool ? d->framePool->statistics() : QAVFramePoolStatistics();
+}
+
+int QAVVideoCodec::write(const QAVPacket &pkt)
+{
+    Q_D(QAVVideoCodec);
+    // Applied from the decoding thread only
+    const int level = d->skipLevel;
+    if (d->avctx && level != d->appliedSkipLevel) {
+        d->avctx->skip_loop_filter = level >= 2 ? AVDISCARD_ALL : level >= 1 ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+        d->avctx->skip_frame = level >= 4 ? AVDISCARD_NONKEY : level >= 3 ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+        d->appliedSkipLevel = level;
+    }
+
+    int ret = QAVFrameCodec::write(pkt);
+    if (ret >= 0 && pkt && d->avctx->skip_frame != AVDISCARD_DEFAULT)
+        ++d->skipSent;
+    return ret;
+}
+
+int QAVVideoCodec::read(QAVStreamFrame &frame)
+{
+    Q_D(QAVVideoCodec);
+    int ret = QAVFrameCodec::read(frame);
+    if (ret >= 0 && d->avctx->skip_frame != AVDISCARD_DEFAULT)
+        ++d->skipReceived;
+    return ret;
+}
+
 QT_END_NAMESPACE
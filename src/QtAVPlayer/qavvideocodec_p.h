@@ -20,6 +20,7 @@
 //
 
 #include "qavframecodec_p.h"
+#include "qavframepool_p.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -34,6 +35,21 @@ public:
     void setDevice(const QSharedPointer<QAVHWDevice> &d);
     QAVHWDevice *device() const;
 
+    // Trades quality for speed by skipping loop filter, non-reference
+    // and non-key frames, 0 means no skipping
+    void setSkipLevel(int level);
+    int skipLevel() const;
+    // Approximate number of frames not returned by the decoder due to skipping
+    qint64 skippedFrames() const;
+
+    // Decodes to buffers reused from a pool limited by bytes, 0 disables the pool.
+    // Must be set before the codec is opened
+    void setFramePoolSize(qint64 bytes);
+    QAVFramePoolStatistics framePoolStatistics() const;
+
+    int write(const QAVPacket &pkt) override;
+    int read(QAVStreamFrame &frame) override;
+
 private:
     Q_DISABLE_COPY(QAVVideoCodec)
     Q_DECLARE_PRIVATE(QAVVideoCodec)
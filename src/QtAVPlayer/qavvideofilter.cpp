@@ -8,6 +8,7 @@
 #include "qavvideofilter_p.h"
 #include "qavfilter_p_p.h"
 #include "qavcodec_p.h"
+#include "qavframe_p.h"
 #include "qavvideoframe.h"
 #include "qavstream.h"
 #include <QDebug>
@@ -49,6 +50,11 @@ QAVVideoFilter::QAVVideoFilter(
 }
 
 int QAVVideoFilter::write(const QAVFrame &frame)
+{
+    return write(QAVFrame(frame));
+}
+
+int QAVVideoFilter::write(QAVFrame &&frame)
 {
     Q_D(QAVVideoFilter);
     if (!frame || frame.stream().stream()->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
@@ -58,16 +64,21 @@ int QAVVideoFilter::write(const QAVFrame &frame)
     if (!d->isEmpty)
         return AVERROR(EAGAIN);
 
-    d->sourceFrame = frame;
     for (const auto &filter : d->inputs) {
-        if (!filter.supports(d->sourceFrame)) {
-            d->sourceFrame = {};
+        if (!filter.supports(frame))
             return AVERROR(ENOTSUP);
-        }
-        QAVFrame ref = d->sourceFrame;
-        int ret = av_buffersrc_add_frame_flags(filter.ctx(), ref.frame(), 0);
+    }
+
+    d->sourceFrame = std::move(frame);
+    // Other copies of the frame are not detached, the filter only reads it
+    const AVFrame *src = std::as_const(d->sourceFrame).frame();
+    for (const auto &filter : d->inputs) {
+        // The filter references the buffers by itself
+        int ret = av_buffersrc_add_frame_flags(filter.ctx(), const_cast<AVFrame *>(src), AV_BUFFERSRC_FLAG_KEEP_REF);
         if (ret < 0)
             return ret;
+        if (src->buf[0])
+            QAVFrameCounters::m_filterRefs.fetch_add(1, std::memory_order_relaxed);
     }
 
     d->isEmpty = false;
@@ -78,7 +89,7 @@ void QAVVideoFilter::read(QAVFrame &frame)
 {
     Q_D(QAVVideoFilter);
     if (d->outputs.isEmpty() || d->isEmpty) {
-        frame = d->sourceFrame;
+        frame = std::move(d->sourceFrame);
         d->sourceFrame = {};
         d->isEmpty = true;
         return;
@@ -89,24 +100,21 @@ void QAVVideoFilter::read(QAVFrame &frame)
         for (int i = 0; i < d->outputs.size(); ++i) {
             const auto &filter = d->outputs[i];
             while (true) {
-                QAVFrame out = d->sourceFrame;
-                // av_buffersink_get_frame_flags allocates frame's data
-                av_frame_unref(out.frame());
+                QAVFrame out;
                 ret = av_buffersink_get_frame_flags(filter.ctx(), out.frame(), 0);
                 if (ret < 0)
                     break;
 
                 if (!out.frame()->pkt_duration)
-                    out.frame()->pkt_duration = d->sourceFrame.frame()->pkt_duration;
+                    out.frame()->pkt_duration = std::as_const(d->sourceFrame).frame()->pkt_duration;
                 out.setFrameRate(av_buffersink_get_frame_rate(filter.ctx()));
                 out.setTimeBase(av_buffersink_get_time_base(filter.ctx()));
                 out.setFilterName(
                     !filter.name().isEmpty()
                     ? filter.name()
                     : QString(QLatin1String("%1:%2")).arg(d->name).arg(QString::number(i)));
-                if (!out.stream())
-                    out.setStream(d->stream);
-                d->outputFrames.push_back(out);
+                out.setStream(d->sourceFrame.stream() ? d->sourceFrame.stream() : d->stream);
+                d->outputFrames.push_back(std::move(out));
             }
         }
     }
@@ -10,6 +10,7 @@
 #include "qavframe_p.h"
 #include "qavvideocodec_p.h"
 #include "qavhwdevice_p.h"
+#include "qavtrace_p.h"
 #include <QSize>
 #ifndef QT_NO_MULTIMEDIA
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -30,47 +31,173 @@ extern "C"
 
 QT_BEGIN_NAMESPACE
 
-static const QAVVideoCodec *videoCodec(const QAVCodec *c)
+struct SwsContextKey
 {
-    return reinterpret_cast<const QAVVideoCodec *>(c);
+    QSize srcSize;
+    AVPixelFormat srcFormat = AV_PIX_FMT_NONE;
+    QSize dstSize;
+    AVPixelFormat dstFormat = AV_PIX_FMT_NONE;
+    int flags = 0;
+    int srcColorspace = SWS_CS_DEFAULT;
+    int dstColorspace = SWS_CS_DEFAULT;
+    // 1 is full range, 0 is limited
+    int srcRange = 0;
+    int dstRange = 0;
+
+    bool operator==(const SwsContextKey &other) const
+    {
+        return srcSize == other.srcSize && srcFormat == other.srcFormat
+            && dstSize == other.dstSize && dstFormat == other.dstFormat
+            && flags == other.flags
+            && srcColorspace == other.srcColorspace && dstColorspace == other.dstColorspace
+            && srcRange == other.srcRange && dstRange == other.dstRange;
+    }
+};
+
+static int swsColorspace(AVColorSpace colorspace, const QSize &size)
+{
+    switch (colorspace) {
+        case AVCOL_SPC_BT709:
+            return SWS_CS_ITU709;
+        case AVCOL_SPC_FCC:
+            return SWS_CS_FCC;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+            return SWS_CS_ITU601;
+        case AVCOL_SPC_SMPTE240M:
+            return SWS_CS_SMPTE240M;
+        case AVCOL_SPC_BT2020_NCL:
+        case AVCOL_SPC_BT2020_CL:
+            return SWS_CS_BT2020;
+        default:
+            // Unknown colorspace is guessed by resolution as players usually do
+            return size.height() > 576 ? SWS_CS_ITU709 : SWS_CS_ITU601;
+    }
 }
 
-class QAVVideoFramePrivate : public QAVFramePrivate
+static bool isRgb(AVPixelFormat fmt)
+{
+    auto desc = av_pix_fmt_desc_get(fmt);
+    return desc && (desc->flags & AV_PIX_FMT_FLAG_RGB);
+}
+
+static bool isFullRange(AVPixelFormat fmt, AVColorRange range)
+{
+    if (isRgb(fmt))
+        return true;
+
+    switch (fmt) {
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_YUVJ440P:
+        case AV_PIX_FMT_YUVJ411P:
+            return true;
+        default:
+            return range == AVCOL_RANGE_JPEG;
+    }
+}
+
+// Keeps recently used scalers of the current thread,
+// so converting every frame does not create a new context
+class SwsContextCache
 {
-    Q_DECLARE_PUBLIC(QAVVideoFrame)
 public:
-    QAVVideoFramePrivate(QAVVideoFrame *q) : q_ptr(q) { }
+    ~SwsContextCache()
+    {
+        for (auto &e : m_entries)
+            sws_freeContext(e.ctx);
+    }
 
-    QAVVideoBuffer &videoBuffer() const
+    SwsContext *get(const SwsContextKey &key)
     {
-        if (!buffer) {
-            auto c = videoCodec(stream.codec().data());
-            auto buf = c && c->device() && frame->format == c->device()->format() ? c->device()->videoBuffer(*q_ptr) : new QAVVideoBuffer_CPU(*q_ptr);
-            const_cast<QAVVideoFramePrivate*>(this)->buffer.reset(buf);
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (m_entries[i].key == key) {
+                if (i > 0)
+                    m_entries.move(i, 0);
+                return m_entries[0].ctx;
+            }
+        }
+
+        auto ctx = sws_getContext(key.srcSize.width(), key.srcSize.height(), key.srcFormat,
+                                  key.dstSize.width(), key.dstSize.height(), key.dstFormat,
+                                  key.flags, NULL, NULL, NULL);
+        if (!ctx)
+            return nullptr;
+
+        int ret = sws_setColorspaceDetails(ctx, sws_getCoefficients(key.srcColorspace), key.srcRange,
+                                           sws_getCoefficients(key.dstColorspace), key.dstRange, 0, 1 << 16, 1 << 16);
+        if (ret == -1) {
+            qWarning() << "Colorspace not supported:" << key.srcColorspace << key.dstColorspace;
+            sws_freeContext(ctx);
+            return nullptr;
         }
 
-        return *buffer;
+        if (m_entries.size() >= maxEntries)
+            sws_freeContext(m_entries.takeLast().ctx);
+        m_entries.prepend({key, ctx});
+        return ctx;
     }
 
-    QAVVideoFrame *q_ptr = nullptr;
+private:
+    struct Entry
+    {
+        SwsContextKey key;
+        SwsContext *ctx = nullptr;
+    };
+    static const int maxEntries = 4;
+    QList<Entry> m_entries;
+};
+
+static thread_local SwsContextCache swsContextCache;
+
+static const QAVVideoCodec *videoCodec(const QAVCodec *c)
+{
+    return reinterpret_cast<const QAVVideoCodec *>(c);
+}
+
+class QAVVideoFrameData : public QAVFrameData
+{
+public:
     QScopedPointer<QAVVideoBuffer> buffer;
 };
 
+// Creates the buffer shared by all copies of the frame, dataMutex must be locked
+static QAVVideoBuffer &videoBuffer(const QAVFramePrivate *d, const QAVVideoFrame &frame)
+{
+    if (!d->videoData) {
+        // The buffer owns a detached copy, otherwise it would keep the data alive
+        QAVVideoFrame copy = frame;
+        copy.detach();
+        auto c = videoCodec(d->stream.codec().data());
+        auto data = new QAVVideoFrameData;
+        data->buffer.reset(c && c->device() && d->frame->format == c->device()->format() ? c->device()->videoBuffer(copy) : new QAVVideoBuffer_CPU(copy));
+        d->videoData.reset(data);
+    }
+
+    return *static_cast<QAVVideoFrameData *>(d->videoData.get())->buffer;
+}
+
 QAVVideoFrame::QAVVideoFrame(QObject *parent)
-    : QAVFrame(*new QAVVideoFramePrivate(this), parent)
+    : QAVFrame(parent)
 {
 }
 
 QAVVideoFrame::QAVVideoFrame(const QAVFrame &other, QObject *parent)
-    : QAVVideoFrame(parent)
+    : QAVFrame(other)
 {
-    operator=(other);
+    Q_UNUSED(parent);
 }
 
 QAVVideoFrame::QAVVideoFrame(const QAVVideoFrame &other, QObject *parent)
-    : QAVVideoFrame(parent)
+    : QAVFrame(other)
+{
+    Q_UNUSED(parent);
+}
+
+QAVVideoFrame::QAVVideoFrame(QAVVideoFrame &&other) noexcept
+    : QAVFrame(std::move(other))
 {
-    operator=(other);
 }
 
 QAVVideoFrame::QAVVideoFrame(const QSize &size, AVPixelFormat fmt, QObject *parent)
@@ -84,17 +211,19 @@ QAVVideoFrame::QAVVideoFrame(const QSize &size, AVPixelFormat fmt, QObject *pare
 
 QAVVideoFrame &QAVVideoFrame::operator=(const QAVFrame &other)
 {
-    Q_D(QAVVideoFrame);
     QAVFrame::operator=(other);
-    d->buffer.reset();
     return *this;
 }
 
 QAVVideoFrame &QAVVideoFrame::operator=(const QAVVideoFrame &other)
 {
-    Q_D(QAVVideoFrame);
     QAVFrame::operator=(other);
-    d->buffer.reset();
+    return *this;
+}
+
+QAVVideoFrame &QAVVideoFrame::operator=(QAVVideoFrame &&other) noexcept
+{
+    QAVFrame::operator=(std::move(other));
     return *this;
 }
 
@@ -106,20 +235,24 @@ QSize QAVVideoFrame::size() const
 
 QAVVideoFrame::MapData QAVVideoFrame::map() const
 {
-    Q_D(const QAVVideoFrame);
-    return d->videoBuffer().map();
+    QAV_TRACE("QAVVideoFrame::map");
+    Q_D(const QAVFrame);
+    QMutexLocker locker(&d->dataMutex);
+    return videoBuffer(d, *this).map();
 }
 
 QAVVideoFrame::HandleType QAVVideoFrame::handleType() const
 {
-    Q_D(const QAVVideoFrame);
-    return d->videoBuffer().handleType();
+    Q_D(const QAVFrame);
+    QMutexLocker locker(&d->dataMutex);
+    return videoBuffer(d, *this).handleType();
 }
 
 QVariant QAVVideoFrame::handle() const
 {
-    Q_D(const QAVVideoFrame);
-    return d->videoBuffer().handle();
+    Q_D(const QAVFrame);
+    QMutexLocker locker(&d->dataMutex);
+    return videoBuffer(d, *this).handle();
 }
 
 AVPixelFormat QAVVideoFrame::format() const
@@ -132,37 +265,113 @@ QString QAVVideoFrame::formatName() const
     return QLatin1String(av_pix_fmt_desc_get(QAVVideoFrame::format())->name);
 }
 
+static int scalingFlags(QAVVideoFrame::ScalingQuality quality)
+{
+    switch (quality) {
+        case QAVVideoFrame::FastBilinearScaling:
+            return SWS_FAST_BILINEAR;
+        case QAVVideoFrame::BilinearScaling:
+            return SWS_BILINEAR;
+        case QAVVideoFrame::AreaScaling:
+            return SWS_AREA;
+        default:
+            return SWS_BICUBIC;
+    }
+}
+
 QAVVideoFrame QAVVideoFrame::convertTo(AVPixelFormat fmt) const
 {
-    if (fmt == frame()->format)
+    return convertTo(fmt, size());
+}
+
+QAVVideoFrame QAVVideoFrame::convertTo(AVPixelFormat fmt, const QSize &size, ScalingQuality quality,
+                                       AVColorSpace colorspace, AVColorRange range) const
+{
+    if (fmt == frame()->format && (size.isEmpty() || size == this->size())
+        && (colorspace == AVCOL_SPC_UNSPECIFIED || colorspace == frame()->colorspace)
+        && (range == AVCOL_RANGE_UNSPECIFIED || range == frame()->color_range))
+    {
         return *this;
+    }
+
+    QAVVideoFrame result;
+    if (!convertTo(fmt, size, result, quality, colorspace, range))
+        return QAVVideoFrame();
+
+    return result;
+}
+
+bool QAVVideoFrame::convertTo(AVPixelFormat fmt, QAVVideoFrame &dst) const
+{
+    return convertTo(fmt, size(), dst);
+}
+
+bool QAVVideoFrame::convertTo(AVPixelFormat fmt, const QSize &size, QAVVideoFrame &dst, ScalingQuality quality,
+                              AVColorSpace colorspace, AVColorRange range) const
+{
+    QAV_TRACE("QAVVideoFrame::convertTo");
+    if (&dst == this) {
+        QAVVideoFrame result;
+        if (!convertTo(fmt, size, result, quality, colorspace, range))
+            return false;
+        dst = result;
+        return true;
+    }
 
     auto mapData = map();
     if (mapData.format == AV_PIX_FMT_NONE) {
         qWarning() << __FUNCTION__ << "Could not map:" << formatName();
-        return QAVVideoFrame();
+        return false;
+    }
+
+    SwsContextKey key;
+    key.srcSize = this->size();
+    key.srcFormat = mapData.format;
+    key.dstSize = size.isEmpty() ? key.srcSize : size;
+    key.dstFormat = fmt;
+    key.flags = scalingFlags(quality);
+
+    // Source colors are described by the frame, destination keeps them if not requested
+    const AVFrame *src = frame();
+    const bool dstRgb = isRgb(fmt);
+    const AVColorSpace dstColorspace = colorspace != AVCOL_SPC_UNSPECIFIED ? colorspace : src->colorspace;
+    AVColorRange dstRange = range;
+    if (dstRange == AVCOL_RANGE_UNSPECIFIED) {
+        dstRange = dstRgb || (!isRgb(mapData.format) && isFullRange(mapData.format, src->color_range))
+                   ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
     }
-    auto ctx = sws_getContext(size().width(), size().height(), mapData.format,
-                              size().width(), size().height(), fmt,
-                              SWS_BICUBIC, NULL, NULL, NULL);
+    key.srcColorspace = swsColorspace(src->colorspace, key.srcSize);
+    // Guessed source colorspace is kept even if scaled to another resolution
+    key.dstColorspace = colorspace != AVCOL_SPC_UNSPECIFIED ? swsColorspace(colorspace, key.dstSize) : key.srcColorspace;
+    key.srcRange = isFullRange(mapData.format, src->color_range) ? 1 : 0;
+    key.dstRange = isFullRange(fmt, dstRange) ? 1 : 0;
+    auto ctx = swsContextCache.get(key);
     if (ctx == nullptr) {
         qWarning() << __FUNCTION__ << ": Could not get sws context:" << formatName();
-        return QAVVideoFrame();
+        return false;
     }
 
-    int ret = sws_setColorspaceDetails(ctx, sws_getCoefficients(SWS_CS_ITU601),
-                                       0, sws_getCoefficients(SWS_CS_ITU709), 0, 0, 1 << 16, 1 << 16);
-    if (ret == -1) {
-        qWarning() << __FUNCTION__ << "Colorspace not support";
-        return QAVVideoFrame();
+    // Buffers of the destination can be overwritten if not shared with other frames
+    const bool detached = dst.isDetached();
+    if (detached)
+        static_cast<QAVFramePrivate *>(dst.d_ptr.data())->videoData.reset();
+    if (!detached || !dst.frame()->data[0] || dst.size() != key.dstSize || dst.format() != fmt
+        || !av_frame_is_writable(dst.frame()))
+    {
+        dst = QAVVideoFrame(key.dstSize, fmt);
+        if (!dst.frame()->data[0]) {
+            qWarning() << __FUNCTION__ << "Could not allocate frame:" << key.dstSize;
+            return false;
+        }
     }
 
-    QAVVideoFrame result(size(), fmt);
-    result.d_ptr->stream = d_ptr->stream;
-    sws_scale(ctx, mapData.data, mapData.bytesPerLine, 0, result.size().height(), result.frame()->data, result.frame()->linesize);
-    sws_freeContext(ctx);
-
-    return result;
+    dst.d_ptr->stream = d_ptr->stream;
+    if (!dstRgb) {
+        dst.frame()->colorspace = dstColorspace;
+        dst.frame()->color_range = key.dstRange ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+    }
+    sws_scale(ctx, mapData.data, mapData.bytesPerLine, 0, key.srcSize.height(), dst.frame()->data, dst.frame()->linesize);
+    return true;
 }
 
 #ifndef QT_NO_MULTIMEDIA
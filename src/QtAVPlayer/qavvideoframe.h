@@ -20,7 +20,6 @@ extern "C" {
 
 QT_BEGIN_NAMESPACE
 
-class QAVVideoFramePrivate;
 class QAVCodec;
 class Q_AVPLAYER_EXPORT QAVVideoFrame : public QAVFrame
 {
@@ -32,13 +31,23 @@ public:
         MTLTextureHandle
     };
 
+    enum ScalingQuality
+    {
+        FastBilinearScaling,
+        BilinearScaling,
+        AreaScaling,
+        BicubicScaling
+    };
+
     QAVVideoFrame(QObject *parent = nullptr);
     QAVVideoFrame(const QAVFrame &other, QObject *parent = nullptr);
     QAVVideoFrame(const QAVVideoFrame &other, QObject *parent = nullptr);
+    QAVVideoFrame(QAVVideoFrame &&other) noexcept;
     QAVVideoFrame(const QSize &size, AVPixelFormat fmt, QObject *parent = nullptr);
 
     QAVVideoFrame &operator=(const QAVFrame &other);
     QAVVideoFrame &operator=(const QAVVideoFrame &other);
+    QAVVideoFrame &operator=(QAVVideoFrame &&other) noexcept;
 
     QSize size() const;
 
@@ -57,14 +66,23 @@ public:
     AVPixelFormat format() const;
     QString formatName() const;
     QAVVideoFrame convertTo(AVPixelFormat fmt) const;
+    // Converts and scales in one pass, empty size keeps the source size.
+    // Source colors are taken from the frame, unspecified destination keeps them
+    QAVVideoFrame convertTo(AVPixelFormat fmt, const QSize &size, ScalingQuality quality = BicubicScaling,
+                            AVColorSpace colorspace = AVCOL_SPC_UNSPECIFIED,
+                            AVColorRange range = AVCOL_RANGE_UNSPECIFIED) const;
+    // Reuses the buffers of dst if possible
+    bool convertTo(AVPixelFormat fmt, QAVVideoFrame &dst) const;
+    bool convertTo(AVPixelFormat fmt, const QSize &size, QAVVideoFrame &dst, ScalingQuality quality = BicubicScaling,
+                   AVColorSpace colorspace = AVCOL_SPC_UNSPECIFIED,
+                   AVColorRange range = AVCOL_RANGE_UNSPECIFIED) const;
 #ifndef QT_NO_MULTIMEDIA
     operator QVideoFrame() const;
 #endif
-
-protected:
-    Q_DECLARE_PRIVATE(QAVVideoFrame)
 };
 
+Q_DECLARE_TYPEINFO(QAVVideoFrame, Q_MOVABLE_TYPE);
+
 Q_DECLARE_METATYPE(QAVVideoFrame)
 Q_DECLARE_METATYPE(AVPixelFormat)
 
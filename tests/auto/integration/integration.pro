@@ -1,3 +1,3 @@
 TEMPLATE = subdirs
 
-SUBDIRS += qavdemuxer qavplayer
+SUBDIRS += qavdemuxer qavplayer qavthumbnailer qavvideoframe qavframereader
@@ -14,6 +14,8 @@
 
 #include <QDebug>
 #include <QtTest/QtTest>
+#include <thread>
+#include <atomic>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -34,8 +36,34 @@ private slots:
     void metadata();
     void videoCodecs();
     void inputOptions();
+    void decodingThreads_data();
+    void decodingThreads();
+    void keyframes();
+    void directIO();
+    void readAhead_data();
+    void readAhead();
+    void memoryIO();
+    void audioConversion();
+    void audioResamplers();
 };
 
+// Demuxes all packets on another thread while the owner thread runs the event loop
+static qint64 demuxInThread(QAVDemuxer &d)
+{
+    std::atomic<bool> done { false };
+    qint64 bytes = 0;
+    std::thread t([&] {
+        QAVPacket p;
+        while ((p = d.read()))
+            bytes += p.packet()->size;
+        done = true;
+    });
+    while (!done)
+        QCoreApplication::processEvents();
+    t.join();
+    return bytes;
+}
+
 void tst_QAVDemuxer::construction()
 {
     QAVDemuxer d;
@@ -141,10 +169,14 @@ void tst_QAVDemuxer::loadAudio()
         QCOMPARE(af.pts(), f.pts());
         QVERIFY(af.stream().codec()->codec() != nullptr);
 
+        // Native 16 bit samples are not converted, but copied to outlive the frame
         auto format = af.format();
-        QCOMPARE(format.sampleFormat(), QAVAudioFormat::Int32);
+        QCOMPARE(format.sampleFormat(), QAVAudioFormat::Int16);
         auto data = af.data();
         QVERIFY(!data.isEmpty());
+        const char *samples = (const char *)std::as_const(af).frame()->data[0];
+        QVERIFY(data.constData() != samples);
+        QCOMPARE(data, QByteArray::fromRawData(samples, data.size()));
 
         QCOMPARE(d.eof(), false);
     }
@@ -341,10 +373,14 @@ void tst_QAVDemuxer::qrcIO()
         QCOMPARE(af.pts(), f.pts());
         QVERIFY(af.stream().codec()->codec() != nullptr);
 
+        // Native 16 bit samples are not converted, but copied to outlive the frame
         auto format = af.format();
-        QCOMPARE(format.sampleFormat(), QAVAudioFormat::Int32);
+        QCOMPARE(format.sampleFormat(), QAVAudioFormat::Int16);
         auto data = af.data();
         QVERIFY(!data.isEmpty());
+        const char *samples = (const char *)std::as_const(af).frame()->data[0];
+        QVERIFY(data.constData() != samples);
+        QCOMPARE(data, QByteArray::fromRawData(samples, data.size()));
 
         QCOMPARE(d.eof(), false);
     }
@@ -428,5 +464,283 @@ void tst_QAVDemuxer::inputOptions()
     QVERIFY(d.load(file.absoluteFilePath()) >= 0);
 }
 
+void tst_QAVDemuxer::decodingThreads_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("threads");
+    QTest::addColumn<int>("type");
+
+    for (auto path: {"../testdata/colors.mp4", "../testdata/DHC0413_CreaseOrNot.mp4", "../testdata/star_trails.mpeg"}) {
+        const QString file = QFileInfo(QLatin1String(path)).fileName();
+        QTest::newRow(qPrintable(file + QLatin1String(": 1 thread"))) << QString(QLatin1String(path)) << 1 << 0;
+        QTest::newRow(qPrintable(file + QLatin1String(": 2 threads, frame"))) << QString(QLatin1String(path)) << 2 << FF_THREAD_FRAME;
+        QTest::newRow(qPrintable(file + QLatin1String(": 4 threads, frame"))) << QString(QLatin1String(path)) << 4 << FF_THREAD_FRAME;
+        QTest::newRow(qPrintable(file + QLatin1String(": 4 threads, slice"))) << QString(QLatin1String(path)) << 4 << FF_THREAD_SLICE;
+        QTest::newRow(qPrintable(file + QLatin1String(": auto"))) << QString(QLatin1String(path)) << 0 << 0;
+    }
+}
+
+void tst_QAVDemuxer::decodingThreads()
+{
+    QFETCH(QString, path);
+    QFETCH(int, threads);
+    QFETCH(int, type);
+
+    auto decodeAll = [&path](int threads, int type) {
+        QAVDemuxer d;
+        d.setDecodingThreads(threads);
+        d.setDecodingThreadType(type);
+        QFileInfo file(path);
+        if (d.load(file.absoluteFilePath()) < 0 || d.currentVideoStreams().isEmpty())
+            return -1;
+
+        const auto stream = d.currentVideoStreams().first();
+        int frames = 0;
+        QAVPacket p;
+        while ((p = d.read())) {
+            if (p.packet()->stream_index != stream.index())
+                continue;
+            QList<QAVFrame> fs;
+            d.decode(p, fs);
+            frames += fs.size();
+        }
+        // Drains frames delayed by frame threading
+        QAVPacket flush;
+        flush.setStream(stream);
+        QList<QAVFrame> fs;
+        d.decode(flush, fs);
+        frames += fs.size();
+        return frames;
+    };
+
+    // Same frames are decoded by any number of threads
+    const int refFrames = decodeAll(1, 0);
+    QVERIFY(refFrames > 0);
+    QCOMPARE(decodeAll(threads, type), refFrames);
+}
+
+void tst_QAVDemuxer::keyframes()
+{
+    QAVDemuxer d;
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(d.load(file.absoluteFilePath()) >= 0);
+    QVERIFY(!d.currentVideoStreams().isEmpty());
+    const int index = d.currentVideoStreams().first().index();
+
+    auto keyframes = d.keyframes(index);
+    QVERIFY(!keyframes.isEmpty());
+    QVERIFY(std::is_sorted(keyframes.begin(), keyframes.end()));
+    QVERIFY(d.keyframes(-1).isEmpty());
+
+    // Seeking lands on a keyframe shown before the position, also when the index is extended by reading
+    for (double pos : { 10.0, 2.5, 7.5, 5.0 }) {
+        QVERIFY(d.seek(pos) >= 0);
+        QAVPacket p;
+        while ((p = d.read()) && p.packet()->stream_index != index) {}
+        QVERIFY(p);
+        QVERIFY(p.packet()->flags & AV_PKT_FLAG_KEY);
+        QVERIFY2(p.pts() <= pos, qPrintable(QString::number(p.pts())));
+    }
+}
+
+void tst_QAVDemuxer::directIO()
+{
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    QFile file(fileInfo.absoluteFilePath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QBuffer buffer;
+    buffer.setData(file.readAll());
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    file.seek(0);
+
+    // Direct reads are only enabled explicitly
+    QAVIODevice fileDev(file);
+    QVERIFY(!fileDev.isDirectRead());
+    fileDev.setDirectRead(true);
+    QVERIFY(fileDev.isDirectRead());
+    QAVIODevice bufferDev(buffer);
+    QVERIFY(!bufferDev.isDirectRead());
+
+    QAVDemuxer d1;
+    QVERIFY(d1.load(QLatin1String("colors.mp4"), &fileDev) >= 0);
+    const qint64 directBytes = demuxInThread(d1);
+    QVERIFY(directBytes > 0);
+
+    QAVDemuxer d2;
+    QVERIFY(d2.load(QLatin1String("colors.mp4"), &bufferDev) >= 0);
+    QCOMPARE(demuxInThread(d2), directBytes);
+}
+
+void tst_QAVDemuxer::readAhead_data()
+{
+    QTest::addColumn<bool>("direct");
+    QTest::addColumn<qint64>("bytes");
+    QTest::addColumn<qint64>("ms");
+    QTest::addColumn<int>("bufferSize");
+
+    QTest::newRow("direct 1MB") << true << qint64(1024 * 1024) << qint64(0) << 0;
+    QTest::newRow("direct 2s") << true << qint64(0) << qint64(2000) << 32 * 1024;
+    QTest::newRow("owner thread 1MB") << false << qint64(1024 * 1024) << qint64(0) << 0;
+    QTest::newRow("owner thread 2s 256KB") << false << qint64(256 * 1024) << qint64(2000) << 128 * 1024;
+}
+
+void tst_QAVDemuxer::readAhead()
+{
+    QFETCH(bool, direct);
+    QFETCH(qint64, bytes);
+    QFETCH(qint64, ms);
+    QFETCH(int, bufferSize);
+
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    QFile refFile(fileInfo.absoluteFilePath());
+    QVERIFY(refFile.open(QIODevice::ReadOnly));
+    QAVIODevice refDev(refFile);
+    QAVDemuxer ref;
+    QVERIFY(ref.load(fileInfo.fileName(), &refDev) >= 0);
+    const qint64 refBytes = demuxInThread(ref);
+
+    QFile file(fileInfo.absoluteFilePath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QAVIODevice dev(file);
+    dev.setDirectRead(direct);
+    if (bufferSize > 0)
+        dev.setBufferSize(bufferSize);
+    dev.setReadAhead(bytes, ms);
+    QCOMPARE(dev.readAheadBytes(), bytes);
+    QCOMPARE(dev.readAheadDuration(), ms);
+    QCOMPARE(dev.bufferSize(), bufferSize > 0 ? bufferSize : 64 * 1024);
+
+    QAVDemuxer d;
+    QVERIFY(d.load(fileInfo.fileName(), &dev) >= 0);
+    // Buffer size is fixed when the context is created
+    dev.setBufferSize(1024);
+    QCOMPARE(dev.bufferSize(), bufferSize > 0 ? bufferSize : 64 * 1024);
+    QCOMPARE(demuxInThread(d), refBytes);
+
+    // Seeking drops or skips cached bytes
+    QVERIFY(d.seek(5) >= 0);
+    QVERIFY(demuxInThread(d) > 0);
+    QVERIFY(d.seek(0) >= 0);
+    QCOMPARE(demuxInThread(d), refBytes);
+}
+
+void tst_QAVDemuxer::memoryIO()
+{
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    QFile file(fileInfo.absoluteFilePath());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const qint64 size = file.size();
+    const uchar *data = file.map(0, size);
+    QVERIFY(data);
+
+    QAVIODevice dev(data, size);
+    QAVDemuxer d;
+    QVERIFY(d.load(fileInfo.fileName(), &dev) >= 0);
+    QCOMPARE(d.seekable(), true);
+    QVERIFY(d.duration() > 15);
+    QVERIFY(!d.currentVideoStreams().isEmpty());
+    QVERIFY(!d.currentAudioStreams().isEmpty());
+
+    QFile refFile(fileInfo.absoluteFilePath());
+    QVERIFY(refFile.open(QIODevice::ReadOnly));
+    QAVIODevice refDev(refFile);
+    QAVDemuxer ref;
+    QVERIFY(ref.load(fileInfo.fileName(), &refDev) >= 0);
+
+    const qint64 bytes = demuxInThread(d);
+    QCOMPARE(bytes, demuxInThread(ref));
+    QVERIFY(d.eof());
+
+    QVERIFY(d.seek(10) >= 0);
+    QVERIFY(!d.eof());
+    QVERIFY(d.read());
+
+    QAVIODevice empty(nullptr, 0);
+    QAVDemuxer d2;
+    QVERIFY(d2.load(QLatin1String("empty.mp4"), &empty) < 0);
+}
+
+void tst_QAVDemuxer::audioConversion()
+{
+    QAVDemuxer d;
+    QFileInfo file(QLatin1String("../testdata/test.wav"));
+    QVERIFY(d.load(file.absoluteFilePath()) >= 0);
+
+    // Samples are converted to the buffers of the codec, reused when released
+    const char *prevData = nullptr;
+    int framesCount = 0;
+    int reallocations = 0;
+    QAVPacket p;
+    while ((p = d.read())) {
+        QList<QAVFrame> fs;
+        d.decode(p, fs);
+        while (!fs.isEmpty()) {
+            QAVAudioFrame af = fs.takeFirst();
+            auto format = af.format();
+            QCOMPARE(format.sampleFormat(), QAVAudioFormat::Int16);
+            format.setSampleFormat(QAVAudioFormat::Int32);
+            const QByteArray data = af.data(format);
+            QCOMPARE(data.size(), af.frame()->nb_samples * format.channelCount() * 4);
+            // Cached by the frame
+            QCOMPARE(af.data(format).constData(), data.constData());
+            if (framesCount++ > 0 && data.constData() != prevData)
+                ++reallocations;
+            prevData = data.constData();
+        }
+    }
+
+    QVERIFY(framesCount > 1);
+    QCOMPARE(reallocations, 0);
+}
+
+void tst_QAVDemuxer::audioResamplers()
+{
+    QAVDemuxer d;
+    QFileInfo file(QLatin1String("../testdata/test.wav"));
+    QVERIFY(d.load(file.absoluteFilePath()) >= 0);
+
+    // Two consumers of different formats keep own resamplers
+    qint64 inSamples = 0;
+    qint64 outSamples48k = 0;
+    qint64 outSamples22k = 0;
+    QAVAudioFormat fmt48k;
+    QAVAudioFormat fmt22k;
+    QAVPacket p;
+    while ((p = d.read())) {
+        QList<QAVFrame> fs;
+        d.decode(p, fs);
+        for (const auto &f : fs) {
+            QAVAudioFrame af = f;
+            if (!inSamples) {
+                fmt48k = af.format();
+                fmt48k.setSampleRate(48000);
+                fmt22k = af.format();
+                fmt22k.setSampleRate(22050);
+                fmt22k.setSampleFormat(QAVAudioFormat::Float);
+            }
+            inSamples += af.frame()->nb_samples;
+            outSamples48k += af.data(fmt48k).size() / 2 / fmt48k.channelCount();
+            outSamples22k += af.data(fmt22k).size() / 4 / fmt22k.channelCount();
+        }
+    }
+
+    QVERIFY(inSamples > 0);
+    // Only the delay of the resamplers is not returned
+    const int maxDelay = 64;
+    QVERIFY(qAbs(outSamples48k - inSamples * 48000 / 44100) < maxDelay);
+    QVERIFY(qAbs(outSamples22k - inSamples / 2) < maxDelay);
+
+    // Samples buffered before the seek are dropped
+    QVERIFY(d.seek(0) >= 0);
+    d.flushCodecBuffers();
+    QList<QAVFrame> fs;
+    while (fs.isEmpty() && (p = d.read()))
+        d.decode(p, fs);
+    QVERIFY(!fs.isEmpty());
+    QAVAudioFrame af = fs.first();
+    const int samples = af.data(fmt48k).size() / 2 / fmt48k.channelCount();
+    QVERIFY(samples <= af.frame()->nb_samples * 48000 / 44100 + 1);
+}
+
 QTEST_MAIN(tst_QAVDemuxer)
 #include "tst_qavdemuxer.moc"
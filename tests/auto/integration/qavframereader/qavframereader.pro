@@ -0,0 +1,10 @@
+TARGET = tst_qavframereader
+
+QT += testlib QtAVPlayer-private
+
+INCLUDEPATH += .
+CONFIG += testcase console
+CONFIG += C++1z
+
+SOURCES += \
+    tst_qavframereader.cpp
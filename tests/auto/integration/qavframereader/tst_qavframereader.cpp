@@ -0,0 +1,235 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavframereader.h"
+
+#include <QDebug>
+#include <QtTest/QtTest>
+#include <thread>
+#include <vector>
+
+QT_USE_NAMESPACE
+
+class tst_QAVFrameReader : public QObject
+{
+    Q_OBJECT
+private slots:
+    void construction();
+    void loadIncorrect();
+    void readVideo();
+    void readAudio();
+    void filters();
+    void seek();
+    void unreadFrames();
+    void parallel();
+};
+
+static int countVideoFrames(QAVFrameReader &r)
+{
+    int count = 0;
+    while (auto frame = r.readVideoFrame()) {
+        if (frame.size().isEmpty())
+            return -1;
+        ++count;
+    }
+    return count;
+}
+
+void tst_QAVFrameReader::construction()
+{
+    QAVFrameReader r;
+    QCOMPARE(r.duration(), 0.0);
+    QVERIFY(r.availableVideoStreams().isEmpty());
+    QVERIFY(r.filters().isEmpty());
+    QCOMPARE(r.maxBufferedFrames(), 64);
+    QCOMPARE(r.droppedFrames(), qint64(0));
+    QVERIFY(!r.readVideoFrame());
+    QVERIFY(!r.readAudioFrame());
+    QVERIFY(r.atEnd());
+}
+
+void tst_QAVFrameReader::loadIncorrect()
+{
+    QAVFrameReader r;
+    QVERIFY(r.load(QLatin1String("unknown.mp4")) < 0);
+    QVERIFY(!r.readVideoFrame());
+}
+
+void tst_QAVFrameReader::readVideo()
+{
+    QAVFrameReader r;
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    QVERIFY(r.duration() > 0);
+    QVERIFY(!r.currentVideoStreams().isEmpty());
+    QVERIFY(!r.atEnd());
+
+    const int count = countVideoFrames(r);
+    QVERIFY(count > 0);
+    QVERIFY(r.atEnd());
+    QVERIFY(!r.readVideoFrame());
+
+    // Reads the same frames again
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    QCOMPARE(countVideoFrames(r), count);
+}
+
+void tst_QAVFrameReader::readAudio()
+{
+    QAVFrameReader r;
+    QFileInfo file(QLatin1String("../testdata/test.wav"));
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    QVERIFY(r.currentVideoStreams().isEmpty());
+    QVERIFY(!r.readVideoFrame());
+
+    int count = 0;
+    qint64 bytes = 0;
+    while (auto frame = r.readAudioFrame()) {
+        QCOMPARE(frame.format().sampleRate(), 44100);
+        bytes += frame.data().size();
+        ++count;
+    }
+    QVERIFY(count > 0);
+    QVERIFY(bytes > 0);
+    QVERIFY(r.atEnd());
+}
+
+void tst_QAVFrameReader::filters()
+{
+    QAVFrameReader r;
+    QCOMPARE(r.setFilters({ QLatin1String("scale=32:24") }), 0);
+    QCOMPARE(r.filters(), QList<QString>({ QLatin1String("scale=32:24") }));
+
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    auto frame = r.readVideoFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame.size(), QSize(32, 24));
+    QVERIFY(!frame.filterName().isEmpty());
+
+    // Previous filters are kept on error
+    QVERIFY(r.setFilters({ QLatin1String("unknown") }) < 0);
+    QCOMPARE(r.filters(), QList<QString>({ QLatin1String("scale=32:24") }));
+    frame = r.readVideoFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame.size(), QSize(32, 24));
+
+    QCOMPARE(r.setFilters({}), 0);
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    frame = r.readVideoFrame();
+    QVERIFY(frame);
+    QVERIFY(frame.filterName().isEmpty());
+    QVERIFY(frame.size() != QSize(32, 24));
+}
+
+void tst_QAVFrameReader::seek()
+{
+    QAVFrameReader r;
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    r.setAudioStreams({});
+    const int count = countVideoFrames(r);
+    QVERIFY(count > 0);
+
+    QVERIFY(r.seek(0) >= 0);
+    QVERIFY(!r.atEnd());
+    QCOMPARE(countVideoFrames(r), count);
+
+    QVERIFY(r.seek(r.duration() / 2) >= 0);
+    auto frame = r.readVideoFrame();
+    QVERIFY(frame);
+    QVERIFY(frame.pts() > 0);
+    QVERIFY(countVideoFrames(r) < count);
+}
+
+void tst_QAVFrameReader::unreadFrames()
+{
+    QAVFrameReader r;
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    QVERIFY(!r.currentAudioStreams().isEmpty());
+
+    // Audio is not kept while only video is read
+    const int videoFrames = countVideoFrames(r);
+    QVERIFY(videoFrames > 0);
+    QVERIFY(r.atEnd());
+    QVERIFY(!r.readAudioFrame());
+    QCOMPARE(r.droppedFrames(), qint64(0));
+
+    // Both types are kept once read, up to the limit
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    QVERIFY(r.readVideoFrame());
+    QVERIFY(r.readAudioFrame());
+    int audio = 0;
+    while (r.readAudioFrame())
+        ++audio;
+    QVERIFY(audio > 0);
+    int video = countVideoFrames(r);
+    QVERIFY(video > 0);
+    QVERIFY(video <= 64);
+    QVERIFY(r.atEnd());
+    // The rest is reported as dropped
+    QCOMPARE(1 + video + r.droppedFrames(), qint64(videoFrames));
+
+    // Nothing is dropped without the limit
+    r.setMaxBufferedFrames(-1);
+    QCOMPARE(r.maxBufferedFrames(), 0);
+    QVERIFY(r.load(file.absoluteFilePath()) >= 0);
+    QCOMPARE(r.droppedFrames(), qint64(0));
+    QVERIFY(r.readVideoFrame());
+    QVERIFY(r.readAudioFrame());
+    while (r.readAudioFrame()) {}
+    video = countVideoFrames(r);
+    QCOMPARE(1 + video, videoFrames);
+    QCOMPARE(r.droppedFrames(), qint64(0));
+}
+
+void tst_QAVFrameReader::parallel()
+{
+    const QStringList files = {
+        QLatin1String("../testdata/colors.mp4"),
+        QLatin1String("../testdata/small.mp4"),
+        QLatin1String("../testdata/star_trails.mpeg"),
+        QLatin1String("../testdata/colors_subtitles.mp4")
+    };
+
+    QList<int> expected;
+    for (const auto &f : files) {
+        QAVFrameReader r;
+        QVERIFY(r.load(QFileInfo(f).absoluteFilePath()) >= 0);
+        r.setAudioStreams({});
+        expected.append(countVideoFrames(r));
+        QVERIFY(expected.last() > 0);
+    }
+
+    // Each worker reads all files by its own readers
+    const int workers = 4;
+    std::vector<QList<int>> results(workers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back([&, i] {
+            for (const auto &f : files) {
+                QAVFrameReader r;
+                r.setDecodingThreads(1);
+                if (r.load(QFileInfo(f).absoluteFilePath()) < 0) {
+                    results[i].append(-1);
+                    continue;
+                }
+                r.setAudioStreams({});
+                results[i].append(countVideoFrames(r));
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    for (const auto &result : results)
+        QCOMPARE(result, expected);
+}
+
+QTEST_MAIN(tst_QAVFrameReader)
+#include "tst_qavframereader.moc"
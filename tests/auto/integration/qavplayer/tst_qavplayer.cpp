@@ -8,9 +8,13 @@
 #include "qavplayer.h"
 #include "qavaudiooutput.h"
 #include "private/qaviodevice_p.h"
+#include "private/qavframe_p.h"
+#include "private/qavtrace_p.h"
+#include "private/qavringbuffer_p.h"
 
 #include <QDebug>
 #include <QtTest/QtTest>
+#include <thread>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -61,10 +65,13 @@ private slots:
 #ifndef QT_NO_MULTIMEDIA
     void audioOutput();
 #endif
+    void ringBuffer();
     void setEmptySource();
     void accurateSeek_data();
     void accurateSeek();
     void lastFrame();
+    void tailFrames_data();
+    void tailFrames();
     void configureFilter();
     void changeSourceFilter();
     void filter_data();
@@ -90,6 +97,20 @@ private slots:
     void multipleStreams();
     void emptyStreams();
     void flushCodecs();
+    void decodeAhead();
+    void frameDropping();
+    void scrubbing();
+    void directIO();
+    void readAhead();
+    void memorySource();
+    void fileMapping();
+    void framePool();
+    void frameRefs();
+    void statistics();
+    void trace();
+    void traceLimit();
+    void maxInFlightFrames();
+    void maxInFlightDetachedFrames();
 };
 
 void tst_QAVPlayer::initTestCase()
@@ -289,7 +310,7 @@ void tst_QAVPlayer::playAudioOutput()
 
     QTRY_VERIFY(p.position() != 0);
     QTRY_VERIFY(frame);
-    QCOMPARE(frame.format().sampleFormat(), QAVAudioFormat::Int32);
+    QCOMPARE(frame.format().sampleFormat(), QAVAudioFormat::Int16);
 
     QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
     QTRY_COMPARE(p.state(), QAVPlayer::StoppedState);
@@ -1357,6 +1378,20 @@ void tst_QAVPlayer::convert()
     QAVVideoFrame converted = videoFrame.convertTo(to);
     QVERIFY(converted);
     QCOMPARE(converted.format(), to);
+
+    // The destination buffers are reused when not shared
+    QAVVideoFrame dst;
+    QVERIFY(videoFrame.convertTo(to, dst));
+    QCOMPARE(dst.format(), to);
+    QCOMPARE(dst.size(), videoFrame.size());
+    const uint8_t *data = dst.frame()->data[0];
+    QVERIFY(videoFrame.convertTo(to, dst));
+    QVERIFY(dst.frame()->data[0] == data);
+
+    QAVVideoFrame shared = dst;
+    QVERIFY(videoFrame.convertTo(to, dst));
+    QVERIFY(dst.frame()->data[0] != shared.frame()->data[0]);
+    QVERIFY(shared.frame()->data[0] == data);
 }
 
 void tst_QAVPlayer::map_data()
@@ -1826,6 +1861,10 @@ void tst_QAVPlayer::audioOutput()
 
     QAVPlayer p;
     QAVAudioOutput out;
+    QCOMPARE(out.latency(), 250);
+    out.setLatency(100);
+    QCOMPARE(out.latency(), 100);
+    QCOMPARE(out.bufferedDuration(), 0);
     QObject::connect(&p, &QAVPlayer::audioFrame, &out, [&out](const QAVAudioFrame &f) { out.play(f); });
 
     p.setSource(file1.absoluteFilePath());
@@ -1835,9 +1874,94 @@ void tst_QAVPlayer::audioOutput()
     p.setSource(file2.absoluteFilePath());
     p.play();
     QTRY_VERIFY(p.position() > 500);
+    QTRY_VERIFY(out.bufferedDuration() > 0);
+    // The buffer is rounded up to the power of two
+    QVERIFY(out.bufferedDuration() <= 2 * out.latency());
 }
 #endif // #ifndef QT_NO_MULTIMEDIA
 
+void tst_QAVPlayer::ringBuffer()
+{
+    QAVRingBuffer ring;
+    ring.resize(100);
+    QCOMPARE(ring.capacity(), size_t(128));
+    QCOMPARE(ring.size(), size_t(0));
+
+    // Empty
+    char buf[256] = {};
+    QCOMPARE(ring.read(buf, 10), size_t(0));
+    QCOMPARE(ring.underruns(), qint64(1));
+    QCOMPARE(ring.read(buf, 10), size_t(0));
+    QCOMPARE(ring.underruns(), qint64(1));
+
+    // Full
+    QByteArray data(200, 0);
+    for (int i = 0; i < data.size(); ++i)
+        data[i] = char(i);
+    QCOMPARE(ring.write(data.constData(), 200), size_t(128));
+    QCOMPARE(ring.size(), size_t(128));
+    QCOMPARE(ring.write(data.constData(), 1), size_t(0));
+
+    // Wraparound
+    QCOMPARE(ring.read(buf, 100), size_t(100));
+    QCOMPARE(QByteArray(buf, 100), data.left(100));
+    QCOMPARE(ring.readPosition(), size_t(100));
+    QCOMPARE(ring.write(data.constData() + 128, 72), size_t(72));
+    QCOMPARE(ring.size(), size_t(100));
+    QCOMPARE(ring.read(buf, 256), size_t(100));
+    QCOMPARE(QByteArray(buf, 100), data.mid(100));
+    QCOMPARE(ring.underruns(), qint64(1));
+
+    // Counted once each time the data runs out
+    QCOMPARE(ring.read(buf, 10), size_t(0));
+    QCOMPARE(ring.read(buf, 10), size_t(0));
+    QCOMPARE(ring.underruns(), qint64(2));
+    QCOMPARE(ring.write(data.constData(), 1), size_t(1));
+    QCOMPARE(ring.read(buf, 10), size_t(1));
+    QCOMPARE(ring.read(buf, 10), size_t(0));
+    QCOMPARE(ring.underruns(), qint64(3));
+
+    ring.resize(64);
+    QCOMPARE(ring.capacity(), size_t(64));
+    QCOMPARE(ring.size(), size_t(0));
+
+    // One producer and one consumer
+    const int total = 1 << 20;
+    quint64 written = 0;
+    quint64 read = 0;
+    std::thread producer([&] {
+        char chunk[37];
+        int pos = 0;
+        while (pos < total) {
+            const int len = qMin(int(sizeof(chunk)), total - pos);
+            for (int i = 0; i < len; ++i)
+                chunk[i] = char((pos + i) * 7);
+            int done = 0;
+            while (done < len)
+                done += int(ring.write(chunk + done, size_t(len - done)));
+            for (int i = 0; i < len; ++i)
+                written += quint8(chunk[i]) * quint64(pos + i);
+            pos += len;
+        }
+    });
+
+    char chunk[23];
+    int pos = 0;
+    bool ordered = true;
+    while (pos < total) {
+        const int len = int(ring.read(chunk, sizeof(chunk)));
+        for (int i = 0; i < len; ++i) {
+            ordered = ordered && chunk[i] == char((pos + i) * 7);
+            read += quint8(chunk[i]) * quint64(pos + i);
+        }
+        pos += len;
+    }
+    producer.join();
+    QVERIFY(ordered);
+    QCOMPARE(read, written);
+    QCOMPARE(ring.size(), size_t(0));
+}
+
 void tst_QAVPlayer::setEmptySource()
 {
     QAVPlayer p;
@@ -2070,6 +2194,43 @@ void tst_QAVPlayer::accurateSeek()
     QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
 }
 
+void tst_QAVPlayer::tailFrames_data()
+{
+    QTest::addColumn<int>("decodeAhead");
+
+    QTest::newRow("decode on play") << 0;
+    QTest::newRow("decode ahead") << 8;
+}
+
+void tst_QAVPlayer::tailFrames()
+{
+    QFETCH(int, decodeAhead);
+
+    QAVPlayer p;
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    p.setDecodeAheadFrames(decodeAhead);
+    p.setSynced(false);
+
+    int framesCount = 0;
+    QAVVideoFrame frame;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) { frame = f; ++framesCount; });
+
+    // End of media is reported only after the last frame is sent
+    int framesAtEnd = -1;
+    QObject::connect(&p, &QAVPlayer::mediaStatusChanged, &p, [&](QAVPlayer::MediaStatus status) {
+        if (status == QAVPlayer::EndOfMedia)
+            framesAtEnd = framesCount;
+    });
+
+    p.setSource(file.absoluteFilePath());
+    p.play();
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesAtEnd, 374);
+    QCOMPARE(framesCount, 374);
+    QVERIFY(frame);
+    QVERIFY(qAbs(frame.pts() + frame.duration() - p.duration() / 1000.0) < 0.2);
+}
+
 void tst_QAVPlayer::lastFrame()
 {
     QAVPlayer p;
@@ -2507,6 +2668,414 @@ void tst_QAVPlayer::filesIOSequential()
     QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
 }
 
+void tst_QAVPlayer::directIO()
+{
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    QFile file(fileInfo.absoluteFilePath());
+    QVERIFY(file.open(QFile::ReadOnly));
+
+    // The buffer is filled before playing, so it can be read from any thread
+    Buffer buffer;
+    buffer.m_buffer = file.readAll();
+    buffer.m_size = buffer.m_buffer.size();
+    buffer.open(QIODevice::ReadOnly);
+
+    QAVPlayer p;
+    QSignalSpy spy(&p, &QAVPlayer::directIOChanged);
+    QVERIFY(!p.isDirectIO());
+    p.setDirectIO(true);
+    QVERIFY(p.isDirectIO());
+    p.setDirectIO(true);
+    QCOMPARE(spy.count(), 1);
+
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) { ++framesCount; });
+    p.setSource(fileInfo.fileName(), &buffer);
+    p.setSynced(false);
+    p.play();
+
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+}
+
+void tst_QAVPlayer::readAhead()
+{
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    QFile file(fileInfo.absoluteFilePath());
+    QVERIFY(file.open(QFile::ReadOnly));
+
+    Buffer buffer;
+    buffer.m_buffer = file.readAll();
+    buffer.m_size = buffer.m_buffer.size();
+    buffer.open(QIODevice::ReadOnly);
+
+    QAVPlayer p;
+    QSignalSpy bufferSpy(&p, &QAVPlayer::ioBufferSizeChanged);
+    QSignalSpy bytesSpy(&p, &QAVPlayer::readAheadBytesChanged);
+    QSignalSpy durationSpy(&p, &QAVPlayer::readAheadDurationChanged);
+    p.setIOBufferSize(16 * 1024);
+    p.setIOBufferSize(16 * 1024);
+    p.setReadAheadBytes(512 * 1024);
+    p.setReadAheadDuration(-1);
+    p.setReadAheadDuration(3000);
+    QCOMPARE(p.ioBufferSize(), 16 * 1024);
+    QCOMPARE(p.readAheadBytes(), qint64(512 * 1024));
+    QCOMPARE(p.readAheadDuration(), qint64(3000));
+    QCOMPARE(bufferSpy.count(), 1);
+    QCOMPARE(bytesSpy.count(), 1);
+    QCOMPARE(durationSpy.count(), 1);
+
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) { ++framesCount; });
+    p.setSource(fileInfo.fileName(), &buffer);
+    p.setSynced(false);
+    p.play();
+
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+
+    framesCount = 0;
+    p.seek(0);
+    p.play();
+    QTRY_VERIFY(framesCount > 0);
+}
+
+void tst_QAVPlayer::memorySource()
+{
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    QFile file(fileInfo.absoluteFilePath());
+    QVERIFY(file.open(QFile::ReadOnly));
+    const QByteArray data = file.readAll();
+
+    QAVPlayer p;
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) { ++framesCount; });
+    p.setSource(fileInfo.fileName(), reinterpret_cast<const uchar *>(data.constData()), data.size());
+    QCOMPARE(p.source(), fileInfo.fileName());
+    p.setSynced(false);
+    p.play();
+
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+    QCOMPARE(p.duration(), 15019);
+
+    QAVVideoFrame frame;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) { frame = f; });
+    p.seek(10000);
+    p.pause();
+    QTRY_VERIFY(frame);
+    QTRY_VERIFY(qAbs(frame.pts() - 10.0) < 1.0);
+
+    // Other data with the same url
+    QFile otherFile(QFileInfo(QLatin1String("../testdata/small.mp4")).absoluteFilePath());
+    QVERIFY(otherFile.open(QFile::ReadOnly));
+    const QByteArray otherData = otherFile.readAll();
+    p.setSource(fileInfo.fileName(), reinterpret_cast<const uchar *>(otherData.constData()), otherData.size());
+    QCOMPARE(p.source(), fileInfo.fileName());
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::LoadedMedia);
+    QVERIFY(p.duration() > 0);
+    QVERIFY(p.duration() != 15019);
+    p.setSource(QString());
+}
+
+void tst_QAVPlayer::fileMapping()
+{
+    QAVPlayer p;
+    QSignalSpy spy(&p, &QAVPlayer::fileMappingChanged);
+    QVERIFY(!p.isFileMapping());
+    p.setFileMapping(true);
+    p.setFileMapping(true);
+    QVERIFY(p.isFileMapping());
+    QCOMPARE(spy.count(), 1);
+
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) { ++framesCount; });
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(fileInfo.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+
+    // Not local files are opened as usual
+    p.setSource(QLatin1String("unknown.mp4"));
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::InvalidMedia);
+}
+
+void tst_QAVPlayer::framePool()
+{
+    QAVPlayer p;
+    QSignalSpy spy(&p, &QAVPlayer::framePoolSizeChanged);
+    QCOMPARE(p.framePoolSize(), qint64(0));
+    p.setFramePoolSize(-1);
+    QCOMPARE(p.framePoolSize(), qint64(0));
+    QCOMPARE(spy.count(), 0);
+    const qint64 cap = 4 * 1024 * 1024;
+    p.setFramePoolSize(cap);
+    p.setFramePoolSize(cap);
+    QCOMPARE(p.framePoolSize(), cap);
+    QCOMPARE(spy.count(), 1);
+
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) { ++framesCount; });
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(fileInfo.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+    auto stats = p.framePoolStatistics();
+    QVERIFY(stats.misses > 0);
+    QVERIFY(stats.hits > stats.misses);
+    QVERIFY(stats.highWaterBytes > 0);
+    QVERIFY(stats.highWaterBytes <= cap);
+
+    // Buffers are allocated without the pool when it is full
+    p.setFramePoolSize(1);
+    p.setSource(QString());
+    framesCount = 0;
+    p.setSource(fileInfo.absoluteFilePath());
+    p.play();
+
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+    stats = p.framePoolStatistics();
+    QCOMPARE(stats.misses, qint64(0));
+    QVERIFY(stats.fallbacks > 0);
+    QCOMPARE(stats.highWaterBytes, qint64(0));
+}
+
+void tst_QAVPlayer::frameRefs()
+{
+    QAVPlayer p;
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) { ++framesCount; });
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    p.setSynced(false);
+
+    // Frames are moved from the decoder to the signal without referencing the buffers again
+    QAVFrameCounters::reset();
+    p.setSource(fileInfo.absoluteFilePath());
+    p.play();
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+    QCOMPARE(QAVFrameCounters::refs(), qint64(0));
+    QCOMPARE(QAVFrameCounters::filterRefs(), qint64(0));
+    QVERIFY(QAVFrameCounters::unrefs() >= framesCount);
+
+    p.setSource(QString());
+    framesCount = 0;
+    QAVFrameCounters::reset();
+    p.setFilter(QLatin1String("negate"));
+    p.setSource(fileInfo.absoluteFilePath());
+    p.play();
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, 374);
+    // The buffer source references each decoded frame once, the frames take no other references
+    QCOMPARE(QAVFrameCounters::refs(), qint64(0));
+    QCOMPARE(QAVFrameCounters::filterRefs(), qint64(framesCount));
+}
+
+void tst_QAVPlayer::statistics()
+{
+    QAVPlayer p;
+    QSignalSpy intervalSpy(&p, &QAVPlayer::statisticsIntervalChanged);
+    QSignalSpy spy(&p, &QAVPlayer::statisticsUpdated);
+    QCOMPARE(p.statisticsInterval(), 0);
+    p.setStatisticsInterval(-1);
+    QCOMPARE(p.statisticsInterval(), 0);
+    p.setStatisticsInterval(50);
+    p.setStatisticsInterval(50);
+    QCOMPARE(p.statisticsInterval(), 50);
+    QCOMPARE(intervalSpy.count(), 1);
+
+    auto stats = p.statistics();
+    QCOMPARE(stats.readBytes, qint64(0));
+    QCOMPARE(stats.video.packets, 0);
+
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(fileInfo.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QTRY_VERIFY(spy.count() > 0);
+
+    stats = p.statistics();
+    QVERIFY(stats.readBytes > 0);
+    QVERIFY(stats.readThroughput > 0);
+    QVERIFY(stats.video.decodeTime > 0);
+    QCOMPARE(stats.video.packets, 0);
+    QCOMPARE(stats.droppedFrames, qint64(0));
+
+    QCOMPARE(p.statistics().seekLatency, qint64(0));
+    QSignalSpy seekedSpy(&p, &QAVPlayer::seeked);
+    p.seek(1000);
+    QTRY_COMPARE(seekedSpy.count(), 1);
+    QVERIFY(p.statistics().seekLatency > 0);
+
+    p.setStatisticsInterval(0);
+    QCOMPARE(p.statisticsInterval(), 0);
+    QCOMPARE(intervalSpy.count(), 2);
+}
+
+void tst_QAVPlayer::trace()
+{
+    QAVPlayer p;
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    QAVTrace::clear();
+    QAVTrace::setEnabled(true);
+    p.setSource(fileInfo.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QAVTrace::setEnabled(false);
+
+    const QByteArray json = QAVTrace::toJson();
+    QJsonParseError error;
+    const auto doc = QJsonDocument::fromJson(json, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(!doc.object().value(QLatin1String("traceEvents")).toArray().isEmpty());
+    QVERIFY(json.contains("\"QAVDemuxer::read\""));
+    QVERIFY(json.contains("\"QAVDemuxer::decode\""));
+    QVERIFY(json.contains("\"QAVQueueClock::wait\""));
+    QVERIFY(json.contains("\"QAVPlayer::videoFrame\""));
+    QVERIFY(json.contains("\"demuxer\""));
+
+    // Buffers of finished threads and tasks are reused
+    QAVTrace::clear();
+    QAVTrace::setEnabled(true);
+    for (int i = 0; i < 10; ++i) {
+        std::thread t([] {
+            {
+                QAVTraceThreadName traceName("worker");
+                QAV_TRACE("worker task");
+            }
+            QAV_TRACE("unnamed task");
+        });
+        t.join();
+    }
+    QAVTrace::setEnabled(false);
+    const QByteArray workers = QAVTrace::toJson();
+    QCOMPARE(int(workers.count("\"args\":{\"name\":\"worker\"}")), 1);
+    QCOMPARE(int(workers.count("\"worker task\"")), 10);
+    QCOMPARE(int(workers.count("\"unnamed task\"")), 10);
+    QCOMPARE(QAVTrace::droppedEvents(), qint64(0));
+    QVERIFY(workers.contains("\"otherData\":{\"droppedEvents\":0}"));
+    QAVTrace::clear();
+}
+
+// Events over the limit are dropped and counted
+void tst_QAVPlayer::traceLimit()
+{
+    QAVTrace::clear();
+    const int maxEvents = QAVTrace::maxEvents();
+    QAVTrace::setMaxEvents(5);
+    QCOMPARE(QAVTrace::maxEvents(), 5);
+    QAVTrace::setEnabled(true);
+    std::thread([] {
+        QAVTraceThreadName traceName("limited");
+        for (int i = 0; i < 8; ++i) {
+            QAV_TRACE("limited task");
+        }
+    }).join();
+    QAVTrace::setEnabled(false);
+    QCOMPARE(QAVTrace::droppedEvents(), qint64(3));
+    const QByteArray json = QAVTrace::toJson();
+    QCOMPARE(int(json.count("\"limited task\"")), 5);
+    QJsonParseError error;
+    const auto doc = QJsonDocument::fromJson(json, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(doc.object().value(QLatin1String("otherData")).toObject().value(QLatin1String("droppedEvents")).toInt(), 3);
+    QAVTrace::setMaxEvents(maxEvents);
+    QAVTrace::clear();
+    QCOMPARE(QAVTrace::droppedEvents(), qint64(0));
+}
+
+void tst_QAVPlayer::maxInFlightFrames()
+{
+    // Frames outlive the player
+    QList<QAVVideoFrame> frames;
+    QAVPlayer p;
+    QSignalSpy spy(&p, &QAVPlayer::maxInFlightFramesChanged);
+    QCOMPARE(p.maxInFlightFrames(), 0);
+    p.setMaxInFlightFrames(-1);
+    QCOMPARE(p.maxInFlightFrames(), 0);
+    p.setMaxInFlightFrames(2);
+    p.setMaxInFlightFrames(2);
+    QCOMPARE(p.maxInFlightFrames(), 2);
+    QCOMPARE(spy.count(), 1);
+
+    int framesCount = 0;
+    bool keep = true;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &frame) {
+        if (keep)
+            frames.append(frame);
+        ++framesCount;
+    });
+
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(fileInfo.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+
+    // Blocked until the consumer releases the frames
+    QTRY_COMPARE(framesCount, 2);
+    QTest::qWait(200);
+    QCOMPARE(framesCount, 2);
+    QCOMPARE(p.inFlightFrames(), 2);
+    QCOMPARE(p.statistics().inFlightFrames, 2);
+
+    frames.clear();
+    QTRY_COMPARE(framesCount, 4);
+    frames.clear();
+    QTRY_VERIFY(framesCount > 4);
+
+    // Released frames are not waited for
+    keep = false;
+    frames.clear();
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(p.inFlightFrames(), 0);
+
+    keep = true;
+    p.seek(0);
+    p.play();
+    QTRY_COMPARE(frames.size(), 2);
+}
+
+void tst_QAVPlayer::maxInFlightDetachedFrames()
+{
+    QList<QAVVideoFrame> frames;
+    QAVPlayer p;
+    p.setMaxInFlightFrames(2);
+
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &frame) {
+        // Only the detached copies are kept
+        QAVVideoFrame copy = frame;
+        copy.detach();
+        frames.append(copy);
+        ++framesCount;
+    });
+
+    QFileInfo fileInfo(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(fileInfo.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+
+    QTRY_COMPARE(framesCount, 2);
+    QTest::qWait(200);
+    QCOMPARE(framesCount, 2);
+    QCOMPARE(p.inFlightFrames(), 2);
+
+    frames.clear();
+    QTRY_COMPARE(framesCount, 4);
+    QTest::qWait(200);
+    QCOMPARE(framesCount, 4);
+    frames.clear();
+}
+
 void tst_QAVPlayer::subfile()
 {
     QAVPlayer p;
@@ -3094,5 +3663,108 @@ void tst_QAVPlayer::flushCodecs()
     QTRY_COMPARE(framesCount, 309);
 }
 
+void tst_QAVPlayer::decodeAhead()
+{
+    QAVPlayer p;
+    QSignalSpy spy(&p, &QAVPlayer::decodeAheadFramesChanged);
+    p.setDecodeAheadFrames(8);
+    p.setDecodeAheadBytes(64 * 1024 * 1024);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(p.decodeAheadFrames(), 8);
+    QCOMPARE(p.decodeAheadBytes(), 64 * 1024 * 1024);
+
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(file.absoluteFilePath());
+    p.setSynced(false);
+
+    int framesCount = 0;
+    QAVVideoFrame frame;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) { frame = f; ++framesCount; });
+
+    p.play();
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
+    QTRY_VERIFY(framesCount > 200);
+
+    qint64 seekPosition = -1;
+    QObject::connect(&p, &QAVPlayer::seeked, &p, [&](qint64 pos) { seekPosition = pos; });
+    framesCount = 0;
+    p.pause();
+    p.seek(5000);
+    QTRY_COMPARE(seekPosition, 5000);
+    QTRY_COMPARE(frame.pts(), 5.0);
+    QTRY_VERIFY(framesCount < 3);
+}
+
+void tst_QAVPlayer::frameDropping()
+{
+    QAVPlayer p;
+    QSignalSpy spy(&p, &QAVPlayer::frameDroppingChanged);
+    QVERIFY(!p.isFrameDropping());
+    p.setFrameDropping(true);
+    QVERIFY(p.isFrameDropping());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(p.droppedFrames(), 0);
+    QCOMPARE(p.skippedFrames(), 0);
+
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(file.absoluteFilePath());
+
+    QAtomicInt framesCount;
+    // Slow consumer makes video late comparing to audio
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) {
+        ++framesCount;
+        QThread::msleep(80);
+    }, Qt::DirectConnection);
+
+    p.play();
+    QTRY_VERIFY_WITH_TIMEOUT(p.droppedFrames() > 0, 10000);
+    QVERIFY(framesCount > 0);
+    p.stop();
+    QTRY_COMPARE(p.state(), QAVPlayer::StoppedState);
+}
+
+void tst_QAVPlayer::scrubbing()
+{
+    QAVPlayer p;
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    p.setSource(file.absoluteFilePath());
+
+    QSignalSpy spy(&p, &QAVPlayer::scrubbingChanged);
+    int framesCount = 0;
+    QAVVideoFrame frame;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) { frame = f; ++framesCount; });
+    int seekedCount = 0;
+    qint64 seekPosition = -1;
+    QObject::connect(&p, &QAVPlayer::seeked, &p, [&](qint64 pos) { seekPosition = pos; ++seekedCount; });
+
+    p.pause();
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::LoadedMedia);
+    QTRY_VERIFY(framesCount > 0);
+
+    QVERIFY(!p.isScrubbing());
+    p.setScrubbing(true);
+    QVERIFY(p.isScrubbing());
+    QCOMPARE(spy.count(), 1);
+
+    framesCount = 0;
+    seekedCount = 0;
+    const int seeks = 30;
+    for (int i = 0; i < seeks; ++i)
+        p.seek(2000 + i * 200);
+    QTRY_VERIFY(seekedCount > 0);
+    QTest::qWait(200);
+    // The seeks are coalesced
+    QVERIFY(seekedCount < seeks);
+    QVERIFY(framesCount < seeks);
+    // Only keyframes are shown
+    QVERIFY(frame.pts() * 1000 <= 2000 + (seeks - 1) * 200);
+
+    seekedCount = 0;
+    p.setScrubbing(false);
+    QCOMPARE(spy.count(), 2);
+    QTRY_COMPARE(seekPosition, 2000 + (seeks - 1) * 200);
+    QTRY_COMPARE(frame.pts(), (2000 + (seeks - 1) * 200) / 1000.0);
+}
+
 QTEST_MAIN(tst_QAVPlayer)
 #include "tst_qavplayer.moc"
@@ -0,0 +1,108 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavthumbnailer.h"
+#include "qavvideoframe.h"
+
+#include <QDebug>
+#include <QtTest/QtTest>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+QT_USE_NAMESPACE
+
+class tst_QAVThumbnailer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void construction();
+    void loadIncorrect();
+    void spriteSheet();
+    void benchmark_data();
+    void benchmark();
+};
+
+void tst_QAVThumbnailer::construction()
+{
+    QAVThumbnailer t;
+    QVERIFY(t.size().isEmpty());
+    QCOMPARE(t.duration(), 0.0);
+    QVERIFY(!t.spriteSheet(4));
+}
+
+void tst_QAVThumbnailer::loadIncorrect()
+{
+    QAVThumbnailer t;
+    QVERIFY(t.load(QLatin1String("unknown.mp4"), QSize(64, 64)) < 0);
+    QFileInfo file(QLatin1String("../testdata/test.wav"));
+    QVERIFY(t.load(file.absoluteFilePath(), QSize(64, 64)) < 0);
+    QFileInfo video(QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(t.load(video.absoluteFilePath(), QSize()) < 0);
+}
+
+void tst_QAVThumbnailer::spriteSheet()
+{
+    QAVThumbnailer t;
+    QFileInfo file(QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(t.load(file.absoluteFilePath(), QSize(40, 30)) >= 0);
+    QCOMPARE(t.size(), QSize(40, 30));
+    QVERIFY(t.duration() > 0);
+
+    auto sheet = t.spriteSheet(6);
+    QVERIFY(sheet);
+    QCOMPARE(sheet.format(), AV_PIX_FMT_RGB32);
+    QCOMPARE(sheet.size(), QSize(3 * 40, 2 * 30));
+
+    // Each tile contains something
+    auto data = sheet.map();
+    for (int i = 0; i < 6; ++i) {
+        const int x = (i % 3) * 40;
+        const int y = (i / 3) * 30;
+        bool empty = true;
+        for (int r = y; r < y + 30 && empty; ++r) {
+            const quint32 *line = reinterpret_cast<const quint32 *>(data.data[0] + r * data.bytesPerLine[0]) + x;
+            for (int c = 0; c < 40 && empty; ++c)
+                empty = (line[c] & 0xffffff) == 0;
+        }
+        QVERIFY2(!empty, qPrintable(QString::number(i)));
+    }
+
+    sheet = t.spriteSheet(5, 5);
+    QCOMPARE(sheet.size(), QSize(5 * 40, 30));
+
+    t.unload();
+    QVERIFY(!t.spriteSheet(4));
+}
+
+void tst_QAVThumbnailer::benchmark_data()
+{
+    QTest::addColumn<QString>("path");
+
+    QTest::newRow("colors.mp4") << QString("../testdata/colors.mp4");
+    QTest::newRow("small.mp4") << QString("../testdata/small.mp4");
+    QTest::newRow("DHC0413_CreaseOrNot.mp4") << QString("../testdata/DHC0413_CreaseOrNot.mp4");
+    QTest::newRow("star_trails.mpeg") << QString("../testdata/star_trails.mpeg");
+}
+
+void tst_QAVThumbnailer::benchmark()
+{
+    QFETCH(QString, path);
+
+    QAVThumbnailer t;
+    QFileInfo file(path);
+    QVERIFY(t.load(file.absoluteFilePath(), QSize(160, 90)) >= 0);
+
+    QAVVideoFrame sheet;
+    QBENCHMARK {
+        sheet = t.spriteSheet(16);
+    }
+    QCOMPARE(sheet.size(), QSize(4 * 160, 4 * 90));
+}
+
+QTEST_MAIN(tst_QAVThumbnailer)
+#include "tst_qavthumbnailer.moc"
@@ -0,0 +1,283 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "private/qavdemuxer_p.h"
+#include "qavvideoframe.h"
+
+#include <QDebug>
+#include <QtTest/QtTest>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+QT_USE_NAMESPACE
+
+// Counts heap allocations made by the test
+static std::atomic<qint64> allocations { 0 };
+
+void *operator new(std::size_t size)
+{
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+static QAVVideoFrame decodeFrame(QAVDemuxer &d, const QString &path)
+{
+    QFileInfo file(path);
+    if (d.load(file.absoluteFilePath()) < 0 || d.currentVideoStreams().isEmpty())
+        return {};
+
+    const int index = d.currentVideoStreams().first().index();
+    QAVPacket p;
+    while ((p = d.read())) {
+        if (p.packet()->stream_index != index)
+            continue;
+        QList<QAVFrame> frames;
+        d.decode(p, frames);
+        if (!frames.isEmpty())
+            return frames.first();
+    }
+
+    return {};
+}
+
+static QAVVideoFrame solidFrame(uint8_t y, uint8_t u, uint8_t v, AVColorSpace colorspace, AVColorRange range,
+                                const QSize &size = QSize(16, 16))
+{
+    QAVVideoFrame frame(size, AV_PIX_FMT_YUV420P);
+    auto f = frame.frame();
+    const uint8_t values[3] = {y, u, v};
+    for (int plane = 0; plane < 3; ++plane) {
+        const int h = plane ? f->height / 2 : f->height;
+        const int w = plane ? f->width / 2 : f->width;
+        for (int row = 0; row < h; ++row)
+            memset(f->data[plane] + row * f->linesize[plane], values[plane], w);
+    }
+    f->colorspace = colorspace;
+    f->color_range = range;
+    return frame;
+}
+
+static quint32 centerPixel(const QAVVideoFrame &frame)
+{
+    auto data = frame.map();
+    const int y = frame.size().height() / 2;
+    const int x = frame.size().width() / 2;
+    return reinterpret_cast<const quint32 *>(data.data[0] + y * data.bytesPerLine[0])[x];
+}
+
+class tst_QAVVideoFrame : public QObject
+{
+    Q_OBJECT
+private slots:
+    void convertScaled_data();
+    void convertScaled();
+    void convertColorRange();
+    void convertColorspace();
+    void sharedCopies();
+    void copyAllocations();
+};
+
+void tst_QAVVideoFrame::convertScaled_data()
+{
+    QTest::addColumn<int>("quality");
+
+    QTest::newRow("fast_bilinear") << int(QAVVideoFrame::FastBilinearScaling);
+    QTest::newRow("bilinear") << int(QAVVideoFrame::BilinearScaling);
+    QTest::newRow("area") << int(QAVVideoFrame::AreaScaling);
+    QTest::newRow("bicubic") << int(QAVVideoFrame::BicubicScaling);
+}
+
+void tst_QAVVideoFrame::convertScaled()
+{
+    QFETCH(int, quality);
+
+    QAVDemuxer d;
+    QAVVideoFrame frame = decodeFrame(d, QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(frame);
+    QCOMPARE(frame.size(), QSize(160, 120));
+
+    auto q = QAVVideoFrame::ScalingQuality(quality);
+    QAVVideoFrame scaled = frame.convertTo(AV_PIX_FMT_RGB32, QSize(80, 60), q);
+    QVERIFY(scaled);
+    QCOMPARE(scaled.format(), AV_PIX_FMT_RGB32);
+    QCOMPARE(scaled.size(), QSize(80, 60));
+
+    auto data = scaled.map();
+    bool empty = true;
+    for (int y = 0; y < 60 && empty; ++y) {
+        const quint32 *line = reinterpret_cast<const quint32 *>(data.data[0] + y * data.bytesPerLine[0]);
+        for (int x = 0; x < 80 && empty; ++x)
+            empty = (line[x] & 0xffffff) == 0;
+    }
+    QVERIFY(!empty);
+
+    // Same format but another size is still scaled
+    QAVVideoFrame resized = frame.convertTo(frame.format(), QSize(32, 24), q);
+    QCOMPARE(resized.format(), frame.format());
+    QCOMPARE(resized.size(), QSize(32, 24));
+
+    // Empty size keeps the source size
+    QCOMPARE(frame.convertTo(AV_PIX_FMT_RGB32, QSize(), q).size(), frame.size());
+
+    QAVVideoFrame dst;
+    QVERIFY(frame.convertTo(AV_PIX_FMT_RGB32, QSize(40, 30), dst, q));
+    QCOMPARE(dst.size(), QSize(40, 30));
+    const uint8_t *ptr = dst.frame()->data[0];
+    QVERIFY(frame.convertTo(AV_PIX_FMT_RGB32, QSize(40, 30), dst, q));
+    QVERIFY(dst.frame()->data[0] == ptr);
+}
+
+void tst_QAVVideoFrame::convertColorRange()
+{
+    // Limited range white is expanded to full
+    auto limited = solidFrame(235, 128, 128, AVCOL_SPC_BT709, AVCOL_RANGE_MPEG);
+    auto rgb = limited.convertTo(AV_PIX_FMT_RGB32, QSize());
+    QCOMPARE(rgb.format(), AV_PIX_FMT_RGB32);
+    QVERIFY(qAbs(int((centerPixel(rgb) >> 16) & 0xff) - 255) <= 2);
+
+    // Full range is kept as is
+    auto full = solidFrame(235, 128, 128, AVCOL_SPC_BT709, AVCOL_RANGE_JPEG);
+    rgb = full.convertTo(AV_PIX_FMT_RGB32, QSize());
+    QVERIFY(qAbs(int((centerPixel(rgb) >> 16) & 0xff) - 235) <= 2);
+
+    // Destination keeps the source range unless requested
+    auto yuv = full.convertTo(AV_PIX_FMT_YUV444P, QSize());
+    QCOMPARE(yuv.frame()->color_range, AVCOL_RANGE_JPEG);
+    QCOMPARE(yuv.frame()->colorspace, AVCOL_SPC_BT709);
+    yuv = full.convertTo(AV_PIX_FMT_YUV444P, QSize(), QAVVideoFrame::BicubicScaling, AVCOL_SPC_UNSPECIFIED, AVCOL_RANGE_MPEG);
+    QCOMPARE(yuv.frame()->color_range, AVCOL_RANGE_MPEG);
+    QVERIFY(qAbs(int(yuv.frame()->data[0][0]) - 218) <= 2);
+}
+
+void tst_QAVVideoFrame::convertColorspace()
+{
+    auto bt601 = solidFrame(128, 64, 192, AVCOL_SPC_SMPTE170M, AVCOL_RANGE_MPEG);
+    auto bt709 = solidFrame(128, 64, 192, AVCOL_SPC_BT709, AVCOL_RANGE_MPEG);
+    const quint32 p601 = centerPixel(bt601.convertTo(AV_PIX_FMT_RGB32, QSize()));
+    const quint32 p709 = centerPixel(bt709.convertTo(AV_PIX_FMT_RGB32, QSize()));
+    // Red differs the most between the matrices: ~232 vs ~245
+    const int r601 = (p601 >> 16) & 0xff;
+    const int r709 = (p709 >> 16) & 0xff;
+    QVERIFY2(r709 - r601 > 8, qPrintable(QString("%1 %2").arg(r601).arg(r709)));
+
+    // Unknown colorspace guessed for 1080p is kept when downscaled to 480p
+    auto hd = solidFrame(128, 64, 192, AVCOL_SPC_UNSPECIFIED, AVCOL_RANGE_MPEG, QSize(1920, 1080));
+    auto sd = hd.convertTo(AV_PIX_FMT_YUV420P, QSize(640, 480));
+    auto f = sd.frame();
+    const int x = 320;
+    const int y = 240;
+    QVERIFY(qAbs(int(f->data[0][y * f->linesize[0] + x]) - 128) <= 2);
+    QVERIFY(qAbs(int(f->data[1][y / 2 * f->linesize[1] + x / 2]) - 64) <= 2);
+    QVERIFY(qAbs(int(f->data[2][y / 2 * f->linesize[2] + x / 2]) - 192) <= 2);
+}
+
+void tst_QAVVideoFrame::sharedCopies()
+{
+    QAVDemuxer d;
+    QAVVideoFrame frame = decodeFrame(d, QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(frame);
+    QVERIFY(frame.isDetached());
+
+    QAVFrame copy = frame;
+    QVERIFY(!frame.isDetached());
+    QVERIFY(std::as_const(copy).frame() == std::as_const(frame).frame());
+
+    // Modifying a copy does not change the others
+    copy.setFilterName(QLatin1String("copy"));
+    QVERIFY(copy.isDetached());
+    QVERIFY(frame.isDetached());
+    QVERIFY(frame.filterName().isEmpty());
+    QCOMPARE(copy.filterName(), QLatin1String("copy"));
+    QVERIFY(std::as_const(copy).frame() != std::as_const(frame).frame());
+    QVERIFY(std::as_const(copy).frame()->data[0] == std::as_const(frame).frame()->data[0]);
+
+    // Writable access detaches too
+    QAVFrame writable = frame;
+    const int64_t pts = std::as_const(frame).frame()->pts;
+    writable.frame()->pts = pts + 1;
+    QVERIFY(writable.isDetached());
+    QVERIFY(frame.isDetached());
+    QCOMPARE(std::as_const(frame).frame()->pts, pts);
+
+    // Mapped data is shared too
+    QAVVideoFrame video = copy;
+    QVERIFY(video.map().data[0] == frame.map().data[0]);
+
+    QAVVideoFrame moved = std::move(video);
+    QVERIFY(moved);
+    QCOMPARE(moved.filterName(), QLatin1String("copy"));
+    // Moved-from frames are empty but usable
+    QVERIFY(!video);
+    QVERIFY(video.filterName().isEmpty());
+    QVERIFY(!video.stream());
+    QVERIFY(std::as_const(video).frame());
+
+    QAVPacket packet;
+    QAVPacket packetCopy = packet;
+    QVERIFY(std::as_const(packetCopy).packet() == std::as_const(packet).packet());
+    packetCopy.setStream(frame.stream());
+    QVERIFY(std::as_const(packetCopy).packet() != std::as_const(packet).packet());
+    QVERIFY(!packet.stream());
+    QVERIFY(packetCopy.stream());
+
+    QAVPacket movedPacket = std::move(packetCopy);
+    QVERIFY(movedPacket.stream());
+    QVERIFY(!packetCopy.stream());
+    QCOMPARE(std::as_const(packetCopy).packet()->size, 0);
+}
+
+void tst_QAVVideoFrame::copyAllocations()
+{
+    QAVDemuxer d;
+    QAVVideoFrame frame = decodeFrame(d, QLatin1String("../testdata/colors.mp4"));
+    QVERIFY(frame);
+    QAVPacket packet;
+    std::vector<QAVFrame> queue;
+    queue.reserve(1);
+
+    // Copies made by the queue, the filters and the signals for every frame
+    auto copies = [&] {
+        queue.push_back(frame);
+        QAVFrame decoded = queue.front();
+        queue.pop_back();
+        QAVFrame filtered = decoded;
+        QAVVideoFrame emitted = filtered;
+        QAVVideoFrame received = emitted;
+        QAVVideoFrame moved = std::move(received);
+        QAVStream stream = moved.stream();
+        QAVPacket packetCopy = packet;
+        QAVPacket packetMoved = std::move(packetCopy);
+    };
+    // The first run creates the empty data shared by moved-from objects
+    copies();
+
+    const int count = 100;
+    const qint64 before = allocations;
+    for (int i = 0; i < count; ++i)
+        copies();
+    QCOMPARE(allocations - before, qint64(0));
+}
+
+QTEST_MAIN(tst_QAVVideoFrame)
+#include "tst_qavvideoframe.moc"
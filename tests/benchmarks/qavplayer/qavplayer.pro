@@ -0,0 +1,10 @@
+TARGET = tst_bench_qavplayer
+
+QT += testlib QtAVPlayer-private
+
+INCLUDEPATH += .
+CONFIG += benchmark console
+CONFIG += C++1z
+
+SOURCES += \
+    tst_bench_qavplayer.cpp
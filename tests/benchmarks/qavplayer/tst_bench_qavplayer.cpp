@@ -0,0 +1,584 @@
+/*********************************************************
+ * Copyright (C) 2021, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavplayer.h"
+#include "qavvideoframe.h"
+#include "qavaudioframe.h"
+#include "private/qavdemuxer_p.h"
+#include "private/qavfilters_p.h"
+#include "private/qaviodevice_p.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QtTest/QtTest>
+#include <atomic>
+#include <thread>
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavcodec/avcodec.h>
+}
+
+QT_USE_NAMESPACE
+
+// Results are reported per data row, use -csv, -xml or -o <file>,<format> to track them
+class tst_QAVPlayerBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void demux_data();
+    void demux();
+    void decode_data();
+    void decode();
+    void decodingThreads_data();
+    void decodingThreads();
+    void ioThroughput_data();
+    void ioThroughput();
+    void filter_data();
+    void filter();
+    void map();
+    void copy();
+    void shells_data();
+    void shells();
+    void convertTo_data();
+    void convertTo();
+    void scale_data();
+    void scale();
+    void audioData_data();
+    void audioData();
+    void firstFrame_data();
+    void firstFrame();
+    void seekLatency_data();
+    void seekLatency();
+};
+
+static QString testData(const QString &name)
+{
+    return QFINDTESTDATA(QLatin1String("../../auto/integration/testdata/") + name);
+}
+
+static void addFiles()
+{
+    QTest::addColumn<QString>("file");
+    for (auto name : { "colors.mp4", "small.mp4", "star_trails.mpeg", "dv_dsf_1_stype_1.dv", "test.wav" })
+        QTest::newRow(name) << testData(QLatin1String(name));
+}
+
+static bool isDecodable(const QAVDemuxer &d, const QAVPacket &p)
+{
+    const auto type = d.currentCodecType(p.packet()->stream_index);
+    return type == AVMEDIA_TYPE_VIDEO || type == AVMEDIA_TYPE_AUDIO;
+}
+
+// Decodes up to max frames of the video or audio stream
+static QList<QAVFrame> decodeFrames(QAVDemuxer &d, const QString &file, AVMediaType type, int max)
+{
+    QList<QAVFrame> result;
+    if (d.load(file) < 0)
+        return result;
+
+    QAVPacket p;
+    while (result.size() < max && (p = d.read())) {
+        if (d.currentCodecType(p.packet()->stream_index) != type)
+            continue;
+        QList<QAVFrame> frames;
+        d.decode(p, frames);
+        result += frames;
+    }
+    return result;
+}
+
+// Synthetic frame, large sizes are not in the test data
+static QAVVideoFrame testFrame(const QSize &size)
+{
+    QAVVideoFrame frame(size, AV_PIX_FMT_YUV420P);
+    auto f = frame.frame();
+    for (int y = 0; y < f->height; ++y) {
+        for (int x = 0; x < f->width; ++x)
+            f->data[0][y * f->linesize[0] + x] = uint8_t(x + y);
+    }
+    for (int plane = 1; plane < 3; ++plane) {
+        for (int y = 0; y < f->height / 2; ++y)
+            memset(f->data[plane] + y * f->linesize[plane], 64 * plane, f->width / 2);
+    }
+    return frame;
+}
+
+void tst_QAVPlayerBenchmark::demux_data()
+{
+    addFiles();
+}
+
+// Packets per second
+void tst_QAVPlayerBenchmark::demux()
+{
+    QFETCH(QString, file);
+
+    QAVDemuxer d;
+    QVERIFY(d.load(file) >= 0);
+    qint64 packets = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while (d.read())
+        ++packets;
+    const qint64 ns = timer.nsecsElapsed();
+    QVERIFY(packets > 0);
+    QTest::setBenchmarkResult(packets * 1e9 / qMax<qint64>(ns, 1), QTest::Events);
+}
+
+void tst_QAVPlayerBenchmark::decode_data()
+{
+    addFiles();
+}
+
+// Decoded frames per second, demuxing is not measured
+void tst_QAVPlayerBenchmark::decode()
+{
+    QFETCH(QString, file);
+
+    QAVDemuxer d;
+    QVERIFY(d.load(file) >= 0);
+    QList<QAVPacket> packets;
+    QAVPacket p;
+    while ((p = d.read())) {
+        if (isDecodable(d, p))
+            packets.append(p);
+    }
+    QVERIFY(!packets.isEmpty());
+
+    qint64 frames = 0;
+    QList<QAVFrame> decoded;
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto &packet : packets) {
+        decoded.clear();
+        d.decode(packet, decoded);
+        frames += decoded.size();
+    }
+    const qint64 ns = timer.nsecsElapsed();
+    QVERIFY(frames > 0);
+    QTest::setBenchmarkResult(frames * 1e9 / qMax<qint64>(ns, 1), QTest::FramesPerSecond);
+}
+
+void tst_QAVPlayerBenchmark::decodingThreads_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::addColumn<int>("threads");
+    QTest::addColumn<int>("type");
+
+    for (auto name : { "colors.mp4", "DHC0413_CreaseOrNot.mp4", "star_trails.mpeg" }) {
+        const QString file = testData(QLatin1String(name));
+        const QString row = QLatin1String(name);
+        QTest::newRow(qPrintable(row + QLatin1String(": 1 thread"))) << file << 1 << 0;
+        QTest::newRow(qPrintable(row + QLatin1String(": 2 threads, frame"))) << file << 2 << FF_THREAD_FRAME;
+        QTest::newRow(qPrintable(row + QLatin1String(": 4 threads, frame"))) << file << 4 << FF_THREAD_FRAME;
+        QTest::newRow(qPrintable(row + QLatin1String(": 4 threads, slice"))) << file << 4 << FF_THREAD_SLICE;
+        QTest::newRow(qPrintable(row + QLatin1String(": auto"))) << file << 0 << 0;
+    }
+}
+
+// Decoded video frames per second, including the frames delayed by frame threading
+void tst_QAVPlayerBenchmark::decodingThreads()
+{
+    QFETCH(QString, file);
+    QFETCH(int, threads);
+    QFETCH(int, type);
+
+    QAVDemuxer d;
+    d.setDecodingThreads(threads);
+    d.setDecodingThreadType(type);
+    QVERIFY(d.load(file) >= 0);
+    QVERIFY(!d.currentVideoStreams().isEmpty());
+    const auto stream = d.currentVideoStreams().first();
+    QList<QAVPacket> packets;
+    QAVPacket p;
+    while ((p = d.read())) {
+        if (p.packet()->stream_index == stream.index())
+            packets.append(p);
+    }
+    QAVPacket flush;
+    flush.setStream(stream);
+    packets.append(flush);
+
+    qint64 frames = 0;
+    QList<QAVFrame> decoded;
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto &packet : packets) {
+        decoded.clear();
+        d.decode(packet, decoded);
+        frames += decoded.size();
+    }
+    const qint64 ns = timer.nsecsElapsed();
+    QVERIFY(frames > 0);
+    QTest::setBenchmarkResult(frames * 1e9 / qMax<qint64>(ns, 1), QTest::FramesPerSecond);
+}
+
+void tst_QAVPlayerBenchmark::ioThroughput_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::addColumn<bool>("direct");
+    QTest::addColumn<int>("busyMs");
+
+    const QString colors = testData(QLatin1String("colors.mp4"));
+    const QString large = testData(QLatin1String("DHC0413_CreaseOrNot.mp4"));
+    QTest::newRow("colors.mp4 owner thread") << colors << false << 0;
+    QTest::newRow("colors.mp4 owner thread busy") << colors << false << 2;
+    QTest::newRow("colors.mp4 direct") << colors << true << 0;
+    QTest::newRow("colors.mp4 direct busy") << colors << true << 2;
+    QTest::newRow("DHC0413_CreaseOrNot.mp4 owner thread busy") << large << false << 2;
+    QTest::newRow("DHC0413_CreaseOrNot.mp4 direct busy") << large << true << 2;
+}
+
+// Bytes per second demuxed from a QIODevice on another thread while its owner thread is busy
+void tst_QAVPlayerBenchmark::ioThroughput()
+{
+    QFETCH(QString, file);
+    QFETCH(bool, direct);
+    QFETCH(int, busyMs);
+
+    QFile f(file);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    QAVIODevice dev(f);
+    dev.setDirectRead(direct);
+    QAVDemuxer d;
+    QVERIFY(d.load(QFileInfo(file).fileName(), &dev) >= 0);
+
+    std::atomic<bool> done { false };
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    std::thread t([&] {
+        QAVPacket p;
+        while ((p = d.read()))
+            bytes += p.packet()->size;
+        done = true;
+    });
+    while (!done) {
+        QCoreApplication::processEvents();
+        if (busyMs > 0)
+            QThread::msleep(busyMs);
+    }
+    t.join();
+    const qint64 ns = timer.nsecsElapsed();
+    QVERIFY(bytes > 0);
+    QTest::setBenchmarkResult(bytes * 1e9 / qMax<qint64>(ns, 1), QTest::BytesPerSecond);
+}
+
+void tst_QAVPlayerBenchmark::filter_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::addColumn<QString>("filter");
+
+    const QString colors = testData(QLatin1String("colors.mp4"));
+    const QString small = testData(QLatin1String("small.mp4"));
+    QTest::newRow("negate") << colors << QStringLiteral("negate");
+    QTest::newRow("scale") << small << QStringLiteral("scale=iw/2:ih/2");
+    QTest::newRow("format") << small << QStringLiteral("format=rgb24");
+    QTest::newRow("hflip,vflip") << small << QStringLiteral("hflip,vflip");
+    QTest::newRow("split,hstack") << colors << QStringLiteral("split[a][b];[a]negate[c];[b][c]hstack");
+}
+
+// Filtered frames per second
+void tst_QAVPlayerBenchmark::filter()
+{
+    QFETCH(QString, file);
+    QFETCH(QString, filter);
+
+    QAVDemuxer d;
+    const auto frames = decodeFrames(d, file, AVMEDIA_TYPE_VIDEO, 100);
+    QVERIFY(!frames.isEmpty());
+
+    QAVFilters filters;
+    QCOMPARE(filters.createFilters({ filter }, frames.first(), d), 0);
+
+    qint64 count = 0;
+    QList<QAVFrame> filtered;
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto &frame : frames) {
+        int ret = filters.write(AVMEDIA_TYPE_VIDEO, frame);
+        if (ret >= 0 || ret == AVERROR(EAGAIN)) {
+            filtered.clear();
+            filters.read(AVMEDIA_TYPE_VIDEO, frame, filtered);
+            count += filtered.size();
+        }
+    }
+    const qint64 ns = timer.nsecsElapsed();
+    QVERIFY(count > 0);
+    QTest::setBenchmarkResult(count * 1e9 / qMax<qint64>(ns, 1), QTest::FramesPerSecond);
+}
+
+void tst_QAVPlayerBenchmark::map()
+{
+    QAVDemuxer d;
+    const auto frames = decodeFrames(d, testData(QLatin1String("small.mp4")), AVMEDIA_TYPE_VIDEO, 1);
+    QVERIFY(!frames.isEmpty());
+    QAVVideoFrame frame = frames.first();
+
+    QBENCHMARK {
+        auto data = frame.map();
+        QVERIFY(data.data[0]);
+    }
+}
+
+// Copies made for every frame on its way to the renderers
+void tst_QAVPlayerBenchmark::copy()
+{
+    QAVDemuxer d;
+    const auto frames = decodeFrames(d, testData(QLatin1String("colors.mp4")), AVMEDIA_TYPE_VIDEO, 1);
+    QVERIFY(!frames.isEmpty());
+    QAVVideoFrame frame = frames.first();
+
+    QBENCHMARK {
+        QAVFrame copy = frame;
+        QAVVideoFrame video = copy;
+        QAVVideoFrame received = video;
+        QAVStream stream = received.stream();
+        Q_UNUSED(stream);
+    }
+}
+
+void tst_QAVPlayerBenchmark::shells_data()
+{
+    QTest::addColumn<int>("threads");
+    QTest::addColumn<bool>("handOff");
+    for (int threads : { 1, 2, 4, 8 }) {
+        QTest::newRow(qPrintable(QString(QLatin1String("%1 threads")).arg(threads))) << threads << false;
+        QTest::newRow(qPrintable(QString(QLatin1String("%1 threads, freed by another thread")).arg(threads))) << threads << true;
+    }
+}
+
+// Frames and packets allocated and freed per second by all threads
+void tst_QAVPlayerBenchmark::shells()
+{
+    QFETCH(int, threads);
+    QFETCH(bool, handOff);
+
+    const int iterations = 100000;
+    const int batch = 32;
+    // Every thread frees the frames allocated by the next one if handing off
+    QVector<QList<QAVFrame>> frames(threads);
+    std::atomic<int> ready { 0 };
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < iterations / batch; ++i) {
+                QList<QAVFrame> allocated;
+                for (int j = 0; j < batch; ++j) {
+                    allocated.append(QAVFrame());
+                    QAVPacket packet;
+                    Q_UNUSED(packet);
+                }
+                if (!handOff)
+                    continue;
+                frames[t] = std::move(allocated);
+                ++ready;
+                while (ready.load() < threads * (2 * i + 1))
+                    std::this_thread::yield();
+                frames[(t + 1) % threads].clear();
+                ++ready;
+                while (ready.load() < threads * (2 * i + 2))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (auto &w : workers)
+        w.join();
+    const qint64 ns = timer.nsecsElapsed();
+    QTest::setBenchmarkResult(qint64(threads) * iterations * 2 * 1e9 / qMax<qint64>(ns, 1), QTest::Events);
+}
+
+void tst_QAVPlayerBenchmark::convertTo_data()
+{
+    QTest::addColumn<int>("format");
+
+    QTest::newRow("rgb24") << int(AV_PIX_FMT_RGB24);
+    QTest::newRow("bgra") << int(AV_PIX_FMT_BGRA);
+    QTest::newRow("nv12") << int(AV_PIX_FMT_NV12);
+}
+
+void tst_QAVPlayerBenchmark::convertTo()
+{
+    QFETCH(int, format);
+
+    QAVDemuxer d;
+    const auto frames = decodeFrames(d, testData(QLatin1String("small.mp4")), AVMEDIA_TYPE_VIDEO, 1);
+    QVERIFY(!frames.isEmpty());
+    QAVVideoFrame frame = frames.first();
+    QAVVideoFrame dst;
+
+    // Reuses the destination frame, as the renderers do
+    QBENCHMARK {
+        QVERIFY(frame.convertTo(AVPixelFormat(format), dst));
+    }
+}
+
+void tst_QAVPlayerBenchmark::scale_data()
+{
+    QTest::addColumn<QSize>("from");
+    QTest::addColumn<int>("quality");
+    QTest::addColumn<bool>("twoPasses");
+
+    const QSize hd(1920, 1080);
+    const QSize uhd(3840, 2160);
+    QTest::newRow("1080p fast_bilinear") << hd << int(QAVVideoFrame::FastBilinearScaling) << false;
+    QTest::newRow("1080p area") << hd << int(QAVVideoFrame::AreaScaling) << false;
+    QTest::newRow("1080p bicubic") << hd << int(QAVVideoFrame::BicubicScaling) << false;
+    QTest::newRow("1080p convert then scale") << hd << int(QAVVideoFrame::BicubicScaling) << true;
+    QTest::newRow("4K fast_bilinear") << uhd << int(QAVVideoFrame::FastBilinearScaling) << false;
+    QTest::newRow("4K area") << uhd << int(QAVVideoFrame::AreaScaling) << false;
+    QTest::newRow("4K bicubic") << uhd << int(QAVVideoFrame::BicubicScaling) << false;
+    QTest::newRow("4K convert then scale") << uhd << int(QAVVideoFrame::BicubicScaling) << true;
+}
+
+// Thumbnails scaled in one pass or converted first
+void tst_QAVPlayerBenchmark::scale()
+{
+    QFETCH(QSize, from);
+    QFETCH(int, quality);
+    QFETCH(bool, twoPasses);
+
+    const QSize thumbnail(320, 180);
+    const auto q = QAVVideoFrame::ScalingQuality(quality);
+    QAVVideoFrame src = testFrame(from);
+    QAVVideoFrame rgb;
+    QAVVideoFrame dst;
+
+    QBENCHMARK {
+        if (twoPasses) {
+            QVERIFY(src.convertTo(AV_PIX_FMT_RGB32, rgb));
+            QVERIFY(rgb.convertTo(AV_PIX_FMT_RGB32, thumbnail, dst, q));
+        } else {
+            QVERIFY(src.convertTo(AV_PIX_FMT_RGB32, thumbnail, dst, q));
+        }
+    }
+}
+
+void tst_QAVPlayerBenchmark::audioData_data()
+{
+    QTest::addColumn<int>("sampleFormat");
+    QTest::addColumn<int>("sampleRate");
+
+    QTest::newRow("native") << int(QAVAudioFormat::Unknown) << 0;
+    QTest::newRow("float") << int(QAVAudioFormat::Float) << 0;
+    QTest::newRow("int32 48000") << int(QAVAudioFormat::Int32) << 48000;
+}
+
+// Converts all frames of the file
+void tst_QAVPlayerBenchmark::audioData()
+{
+    QFETCH(int, sampleFormat);
+    QFETCH(int, sampleRate);
+
+    QAVDemuxer d;
+    const auto decoded = decodeFrames(d, testData(QLatin1String("test.wav")), AVMEDIA_TYPE_AUDIO, 1000);
+    QVERIFY(!decoded.isEmpty());
+
+    QList<QAVAudioFrame> frames;
+    for (const auto &frame : decoded)
+        frames.append(frame);
+
+    QAVAudioFormat format = frames.first().format();
+    if (sampleFormat != QAVAudioFormat::Unknown)
+        format.setSampleFormat(QAVAudioFormat::SampleFormat(sampleFormat));
+    if (sampleRate > 0)
+        format.setSampleRate(sampleRate);
+
+    QBENCHMARK {
+        for (const auto &frame : frames) {
+            // Converted data is cached by the frame and its copies
+            QAVAudioFrame copy = frame;
+            copy.detach();
+            QVERIFY(!copy.data(format).isEmpty());
+        }
+    }
+}
+
+void tst_QAVPlayerBenchmark::firstFrame_data()
+{
+    QTest::addColumn<QString>("file");
+
+    for (auto name : { "colors.mp4", "small.mp4", "star_trails.mpeg" })
+        QTest::newRow(name) << testData(QLatin1String(name));
+}
+
+// Time from setSource() to the first video frame
+void tst_QAVPlayerBenchmark::firstFrame()
+{
+    QFETCH(QString, file);
+
+    QBENCHMARK {
+        QAVPlayer p;
+        QEventLoop loop;
+        bool received = false;
+        QObject::connect(&p, &QAVPlayer::videoFrame, &loop, [&] {
+            received = true;
+            loop.quit();
+        });
+        QTimer::singleShot(10000, &loop, &QEventLoop::quit);
+        p.setSource(file);
+        p.play();
+        loop.exec();
+        QVERIFY(received);
+    }
+}
+
+void tst_QAVPlayerBenchmark::seekLatency_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::addColumn<int>("percentile");
+
+    for (auto name : { "colors.mp4", "small.mp4", "DHC0413_CreaseOrNot.mp4", "star_trails.mpeg" }) {
+        for (int percentile : { 50, 90, 99, 100 }) {
+            const QString row = percentile < 100 ? QString(QLatin1String("%1 p%2")).arg(QLatin1String(name)).arg(percentile)
+                                                 : QString(QLatin1String("%1 max")).arg(QLatin1String(name));
+            QTest::newRow(qPrintable(row)) << testData(QLatin1String(name)) << percentile;
+        }
+    }
+}
+
+// Time from seek() to the first video frame, the tail shows the slow seeks
+void tst_QAVPlayerBenchmark::seekLatency()
+{
+    QFETCH(QString, file);
+    QFETCH(int, percentile);
+
+    QAVPlayer p;
+    p.setSource(file);
+
+    QElapsedTimer timer;
+    QAtomicInteger<qint64> firstFrameTime = -1;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &) {
+        if (timer.isValid())
+            firstFrameTime.testAndSetRelaxed(-1, timer.nsecsElapsed());
+    }, Qt::DirectConnection);
+
+    p.pause();
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::LoadedMedia);
+    QVERIFY(p.duration() > 0);
+
+    // Positions are visited out of order to avoid reading ahead
+    const int seeks = 50;
+    QList<qint64> latencies;
+    for (int i = 0; i < seeks; ++i) {
+        firstFrameTime = -1;
+        timer.start();
+        p.seek(p.duration() * (i * 37 % seeks) / seeks);
+        QTRY_VERIFY(firstFrameTime >= 0);
+        latencies.append(firstFrameTime);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    QTest::setBenchmarkResult(latencies[(latencies.size() - 1) * percentile / 100] / 1e6, QTest::WalltimeMilliseconds);
+}
+
+QTEST_MAIN(tst_QAVPlayerBenchmark)
+#include "tst_bench_qavplayer.moc"